@@ -0,0 +1,165 @@
+// Nirnia headless tools (no window, no renderer).
+//
+//   NirniaHeadless verify [--manifest <path>] [--threads <n>] [--terrain <path>]
+//       Generates the reference region, checks that generating it on 1 thread and on n threads gives the same
+//       chunks, and compares the chunk hashes against the golden manifest.  With no manifest, only the thread check
+//       is made (and a warning is printed).
+//
+//   NirniaHeadless record [--manifest <path>] [--radius <chunks>] [--chunk-size <tiles>] [--terrain <path>]
+//       (Re)writes the golden manifest.  Only do this when a change to the world is intended.
+//
+//   NirniaHeadless serve [--observers <n>] [--threads <n>] [--radius <chunks>] [--chunk-size <tiles>] [--duration <s>]
+//                        [--time-scale <k>] [--speed <tiles/s>] [--spread <tiles>] [--stagger <s>] [--seed <n>]
+//                        [--replay <recording>] [--csv <path>] [--terrain <path>]
+//       Load test: runs a world server (shared chunk store and generator threads) for many observers moving about at
+//       once, and reports generation throughput, each observer's time to chunk, and memory use.
+//
+// Exit code is 0 on success, 1 on any mismatch (or error).
+
+#include "LoadTest.h"
+#include "RegionHash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace {
+
+	struct Options {
+		std::string Mode;
+		std::string Manifest = "assets/verify/golden.manifest";
+		std::string Terrain = WorldGenerator::DefaultTerrainPath;
+		uint32_t Threads = std::max(2u, std::thread::hardware_concurrency());
+		ReferenceRegion Region;
+		LoadTestOptions Load;
+	};
+
+
+	bool ParseOptions(int argc, char** argv, Options& options) {
+		if (argc < 2) {
+			return false;
+		}
+		options.Mode = argv[1];
+		for (int arg = 2; arg < argc; ++arg) {
+			const bool hasValue = arg + 1 < argc;
+			if (hasValue && (std::strcmp(argv[arg], "--manifest") == 0)) {
+				options.Manifest = argv[++arg];
+			} else if (hasValue && (std::strcmp(argv[arg], "--terrain") == 0)) {
+				options.Terrain = argv[++arg];
+			} else if (hasValue && (std::strcmp(argv[arg], "--threads") == 0)) {
+				options.Threads = std::max(1, std::atoi(argv[++arg]));
+			} else if (hasValue && (std::strcmp(argv[arg], "--radius") == 0)) {
+				options.Region.Radius = std::max(1, std::atoi(argv[++arg]));
+				options.Load.Radius = options.Region.Radius;
+			} else if (hasValue && (std::strcmp(argv[arg], "--chunk-size") == 0)) {
+				options.Region.ChunkSize = std::clamp(std::atoi(argv[++arg]), 2, MaxChunkSize);
+				options.Load.ChunkSize = options.Region.ChunkSize;
+			} else if (hasValue && (std::strcmp(argv[arg], "--observers") == 0)) {
+				options.Load.Observers = std::max(1, std::atoi(argv[++arg]));
+			} else if (hasValue && (std::strcmp(argv[arg], "--duration") == 0)) {
+				options.Load.Duration = std::max(0.0f, static_cast<float>(std::atof(argv[++arg])));
+			} else if (hasValue && (std::strcmp(argv[arg], "--time-scale") == 0)) {
+				options.Load.TimeScale = std::max(0.01f, static_cast<float>(std::atof(argv[++arg])));
+			} else if (hasValue && (std::strcmp(argv[arg], "--speed") == 0)) {
+				options.Load.Speed = std::max(0.0f, static_cast<float>(std::atof(argv[++arg])));
+			} else if (hasValue && (std::strcmp(argv[arg], "--spread") == 0)) {
+				options.Load.Spread = std::max(0.0f, static_cast<float>(std::atof(argv[++arg])));
+			} else if (hasValue && (std::strcmp(argv[arg], "--stagger") == 0)) {
+				options.Load.Stagger = std::max(0.0f, static_cast<float>(std::atof(argv[++arg])));
+			} else if (hasValue && (std::strcmp(argv[arg], "--seed") == 0)) {
+				options.Load.Seed = static_cast<uint32_t>(std::strtoul(argv[++arg], nullptr, 10));
+			} else if (hasValue && (std::strcmp(argv[arg], "--replay") == 0)) {
+				options.Load.Replay = argv[++arg];
+			} else if (hasValue && (std::strcmp(argv[arg], "--csv") == 0)) {
+				options.Load.Csv = argv[++arg];
+			} else {
+				return false;
+			}
+		}
+		return (options.Mode == "verify") || (options.Mode == "record") || (options.Mode == "serve");
+	}
+
+
+	std::vector<ChunkHashEntry> TimedHashRegion(const WorldGenerator& generator, const ReferenceRegion& region, const uint32_t numThreads) {
+		auto start = std::chrono::steady_clock::now();
+		std::vector<ChunkHashEntry> hashes = HashRegion(generator, region, numThreads);
+		float time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::printf("Generated %zu chunks on %u thread(s) in %.1f ms\n", hashes.size(), numThreads, time);
+		return hashes;
+	}
+
+
+	// Reports differences between two sets of hashes.  Returns number of chunks that differ.
+	size_t Compare(const char* what, const std::vector<ChunkHashEntry>& expected, const std::vector<ChunkHashEntry>& actual) {
+		size_t mismatches = 0;
+		if (expected.size() != actual.size()) {
+			std::printf("%s: chunk count differs (%zu vs %zu)\n", what, expected.size(), actual.size());
+			return std::max(expected.size(), actual.size());
+		}
+		for (size_t n = 0; n < expected.size(); ++n) {
+			if (expected[n] != actual[n]) {
+				if (++mismatches <= 10) {
+					std::printf("%s: chunk (%d, %d) differs\n", what, actual[n].I, actual[n].J);
+				}
+			}
+		}
+		std::printf("%s: %s (%zu of %zu chunks differ)\n", what, mismatches ? "FAILED" : "ok", mismatches, expected.size());
+		return mismatches;
+	}
+
+}
+
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!ParseOptions(argc, argv, options)) {
+		std::printf("usage: %s verify|record [--manifest <path>] [--threads <n>] [--radius <chunks>] [--chunk-size <tiles>] [--terrain <path>]\n", argv[0]);
+		std::printf("       %s serve [--observers <n>] [--threads <n>] [--radius <chunks>] [--chunk-size <tiles>] [--duration <s>] [--time-scale <k>]\n"
+			"             [--speed <tiles/s>] [--spread <tiles>] [--stagger <s>] [--seed <n>] [--replay <recording>] [--csv <path>] [--terrain <path>]\n", argv[0]);
+		return 1;
+	}
+
+	WorldGenerator generator;
+	std::string error;
+	if (!generator.Load(options.Terrain, error)) {
+		std::printf("Could not load terrain: %s\n", error.c_str());
+		return 1;
+	}
+
+	if (options.Mode == "serve") {
+		options.Load.Threads = options.Threads;
+		return RunLoadTest(generator, options.Load) ? 0 : 1;
+	}
+
+	if (options.Mode == "record") {
+		std::vector<ChunkHashEntry> hashes = TimedHashRegion(generator, options.Region, options.Threads);
+		if (!SaveManifest(options.Manifest, options.Region, hashes)) {
+			std::printf("Could not write manifest '%s'\n", options.Manifest.c_str());
+			return 1;
+		}
+		std::printf("Wrote %zu chunk hashes to '%s'\n", hashes.size(), options.Manifest.c_str());
+		return 0;
+	}
+
+	// The golden manifest decides the region (so that it always matches what was recorded)
+	ReferenceRegion region = options.Region;
+	std::vector<ChunkHashEntry> golden;
+	bool haveGolden = LoadManifest(options.Manifest, region, golden);
+	if (!haveGolden) {
+		std::printf("WARNING: could not read manifest '%s'.  Checking thread determinism only, the world itself is NOT verified (run record to create the manifest).\n", options.Manifest.c_str());
+		region = options.Region;
+	}
+
+	size_t mismatches = 0;
+	std::vector<ChunkHashEntry> single = TimedHashRegion(generator, region, 1);
+	std::vector<ChunkHashEntry> multi = TimedHashRegion(generator, region, options.Threads);
+	mismatches += Compare("1 thread vs N threads", single, multi);
+	if (haveGolden) {
+		mismatches += Compare("Golden manifest", golden, single);
+	}
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,330 @@
+#include "LoadTest.h"
+
+#include "InputReplay.h"
+#include "MemoryTracking.h"
+#include "Navigation.h"
+#include "Random.h"
+#include "Simulation.h"
+#include "WorldServer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	using Clock = WorldServer::Clock;
+
+	constexpr float WanderDistance = 256.0f;   // furthest (on each axis) that a wandering observer's next waypoint can be
+
+	// A chunk that an observer has acquired, but that was not resident yet
+	struct PendingChunk {
+		int I;
+		int J;
+		Clock::time_point Requested;
+	};
+
+
+	struct Observer {
+		glm::vec2 Position;
+		glm::vec2 Target;                      // waypoint (wandering observers)
+		Random Randomizer;
+		InputRecording Recording;              // (replaying observers.  Each has its own copy, as lookups are stateful)
+		uint64_t JoinTick = 0;
+		bool Joined = false;
+		int ChunkI = 0;                        // chunk that the held window of chunks is centred on
+		int ChunkJ = 0;
+		std::vector<PendingChunk> Pending;
+
+		uint64_t Requests = 0;                 // chunks acquired
+		uint64_t Waits = 0;                    // ... that had to be waited for
+		double WaitTime = 0.0;                 // total milliseconds waited
+		float MaxWaitTime = 0.0f;
+		uint64_t StallTicks = 0;               // ticks spent in a chunk that was not resident yet
+	};
+
+
+	bool IsInWindow(const int i, const int j, const int centreI, const int centreJ, const int radius) {
+		return (std::abs(i - centreI) <= radius) && (std::abs(j - centreJ) <= radius);
+	}
+
+
+	// Centres the observer's window of chunks on chunk (centreI, centreJ): acquires the chunks that come into the
+	// window, and releases those that leave it
+	void MoveWindow(WorldServer& server, Observer& observer, const int centreI, const int centreJ, const int radius) {
+		const Clock::time_point now = Clock::now();
+		for (int j = centreJ - radius; j <= centreJ + radius; ++j) {
+			for (int i = centreI - radius; i <= centreI + radius; ++i) {
+				if (!observer.Joined || !IsInWindow(i, j, observer.ChunkI, observer.ChunkJ, radius)) {
+					++observer.Requests;
+					if (!server.Acquire(i, j)) {
+						observer.Pending.push_back({i, j, now});
+					}
+				}
+			}
+		}
+		if (observer.Joined) {
+			for (int j = observer.ChunkJ - radius; j <= observer.ChunkJ + radius; ++j) {
+				for (int i = observer.ChunkI - radius; i <= observer.ChunkI + radius; ++i) {
+					if (!IsInWindow(i, j, centreI, centreJ, radius)) {
+						server.Release(i, j);
+					}
+				}
+			}
+			observer.Pending.erase(std::remove_if(observer.Pending.begin(), observer.Pending.end(), [&](const PendingChunk& pending) {
+				return !IsInWindow(pending.I, pending.J, centreI, centreJ, radius);
+			}), observer.Pending.end());
+		}
+		observer.ChunkI = centreI;
+		observer.ChunkJ = centreJ;
+		observer.Joined = true;
+	}
+
+
+	void LeaveWindow(WorldServer& server, Observer& observer, const int radius) {
+		if (observer.Joined) {
+			for (int j = observer.ChunkJ - radius; j <= observer.ChunkJ + radius; ++j) {
+				for (int i = observer.ChunkI - radius; i <= observer.ChunkI + radius; ++i) {
+					server.Release(i, j);
+				}
+			}
+			observer.Joined = false;
+		}
+	}
+
+
+	// Collects the time to chunk of pending chunks that have become resident
+	void Poll(const WorldServer& server, Observer& observer, std::vector<float>& waitTimes) {
+		observer.Pending.erase(std::remove_if(observer.Pending.begin(), observer.Pending.end(), [&](const PendingChunk& pending) {
+			Clock::time_point ready;
+			if (!server.GetReadyTime(pending.I, pending.J, ready)) {
+				return false;
+			}
+			// (a chunk that was already being generated can be stamped ready a moment before it was asked for)
+			float time = std::max(0.0f, std::chrono::duration<float, std::milli>(ready - pending.Requested).count());
+			++observer.Waits;
+			observer.WaitTime += time;
+			observer.MaxWaitTime = std::max(observer.MaxWaitTime, time);
+			waitTimes.push_back(time);
+			return true;
+		}), observer.Pending.end());
+	}
+
+
+	void Wander(Observer& observer, const float speed) {
+		const float step = speed * Simulation::TickDuration;
+		const glm::vec2 delta = observer.Target - observer.Position;
+		const float distance = glm::length(delta);
+		if (distance <= step) {
+			observer.Position = observer.Target;
+			observer.Target += glm::vec2{observer.Randomizer.Uniform(-WanderDistance, WanderDistance), observer.Randomizer.Uniform(-WanderDistance, WanderDistance)};
+		} else {
+			observer.Position += delta * (step / distance);
+		}
+	}
+
+
+	// Moves as Simulation::UpdatePlayer() does (but without collisions)
+	void Replay(Observer& observer, const uint64_t tick) {
+		constexpr float distance = Simulation::PlayerSpeed * Simulation::TickDuration;
+
+		SimulationInput input;
+		input.Keys = observer.Recording.GetKeys((tick - observer.JoinTick) % observer.Recording.GetLength());
+		if (input.IsPressed(InputKey::Left)) {
+			observer.Position.x -= distance;
+		} else if (input.IsPressed(InputKey::Right)) {
+			observer.Position.x += distance;
+		}
+		if (input.IsPressed(InputKey::Up)) {
+			observer.Position.y += distance;
+		} else if (input.IsPressed(InputKey::Down)) {
+			observer.Position.y -= distance;
+		}
+	}
+
+
+	// Value below which the given fraction of values lie (values is reordered)
+	float GetPercentile(std::vector<float>& values, const float fraction) {
+		if (values.empty()) {
+			return 0.0f;
+		}
+		auto nth = values.begin() + std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+		std::nth_element(values.begin(), nth, values.end());
+		return *nth;
+	}
+
+
+	float ToMB(const size_t bytes) {
+		return bytes / (1024.0f * 1024.0f);
+	}
+
+
+	bool WriteCsv(const std::string& path, const std::vector<Observer>& observers) {
+		std::ofstream file(path);
+		if (!file) {
+			return false;
+		}
+		file << "observer,requests,waits,mean_wait_ms,max_wait_ms,stall_seconds,still_waiting\n";
+		for (size_t n = 0; n < observers.size(); ++n) {
+			const Observer& observer = observers[n];
+			file << n << "," << observer.Requests << "," << observer.Waits << ","
+				<< (observer.Waits ? observer.WaitTime / observer.Waits : 0.0) << "," << observer.MaxWaitTime << ","
+				<< observer.StallTicks * Simulation::TickDuration << "," << observer.Pending.size() << "\n";
+		}
+		return static_cast<bool>(file);
+	}
+
+}
+
+
+bool RunLoadTest(const WorldGenerator& generator, const LoadTestOptions& options) {
+	InputRecording recording;
+	if (!options.Replay.empty() && (!recording.Load(options.Replay) || (recording.GetLength() == 0))) {
+		std::printf("Could not read input recording '%s'\n", options.Replay.c_str());
+		return false;
+	}
+
+	std::vector<Observer> observers(options.Observers);
+	for (uint32_t n = 0; n < options.Observers; ++n) {
+		Observer& observer = observers[n];
+		observer.Randomizer = Random({options.Seed, n});
+		observer.Position = {observer.Randomizer.Uniform(-options.Spread, options.Spread), observer.Randomizer.Uniform(-options.Spread, options.Spread)};
+		observer.Target = observer.Position;
+		observer.JoinTick = static_cast<uint64_t>(n * options.Stagger * Simulation::TickRate);
+		if (!options.Replay.empty()) {
+			observer.Recording = recording;
+		}
+	}
+
+	std::printf("%u observers (%s), chunk size %d, radius %d, %u generator thread(s)\n", options.Observers,
+		options.Replay.empty() ? "wandering" : "replaying input", options.ChunkSize, options.Radius, options.Threads);
+
+	WorldServer server(generator, options.ChunkSize);
+	server.Start(options.Threads);
+
+	// Observers are updated at the simulation's tick rate, on this thread.  If that takes longer than a tick, the test
+	// falls behind real time (which is reported), rather than observers skipping ticks.
+	const uint64_t ticks = static_cast<uint64_t>(std::ceil(options.Duration * Simulation::TickRate));
+	const auto tickDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(Simulation::TickDuration / options.TimeScale));
+	std::vector<float> waitTimes;
+	uint64_t lateTicks = 0;
+	Clock::duration busyTime{0};
+	const Clock::time_point start = Clock::now();
+	Clock::time_point nextReport = start + std::chrono::seconds(1);
+	uint64_t reportedGenerated = 0;
+	for (uint64_t tick = 0; tick < ticks; ++tick) {
+		const Clock::time_point tickStart = Clock::now();
+		for (Observer& observer : observers) {
+			if (!observer.Joined) {
+				if (tick < observer.JoinTick) {
+					continue;
+				}
+			} else if (options.Replay.empty()) {
+				Wander(observer, options.Speed);
+			} else {
+				Replay(observer, tick);
+			}
+			const glm::ivec2 tile = GetTile(observer.Position);
+			const int i = NavLayout::FloorDiv(tile.x, options.ChunkSize);
+			const int j = NavLayout::FloorDiv(tile.y, options.ChunkSize);
+			if (!observer.Joined || (i != observer.ChunkI) || (j != observer.ChunkJ)) {
+				MoveWindow(server, observer, i, j, options.Radius);
+			}
+			if (!observer.Pending.empty()) {
+				Poll(server, observer, waitTimes);
+				observer.StallTicks += std::any_of(observer.Pending.begin(), observer.Pending.end(), [&](const PendingChunk& pending) {
+					return (pending.I == observer.ChunkI) && (pending.J == observer.ChunkJ);
+				}) ? 1 : 0;
+			}
+		}
+
+		const Clock::time_point now = Clock::now();
+		busyTime += now - tickStart;
+		if (now >= nextReport) {
+			WorldServerStats stats = server.GetStats();
+			std::printf("  %5.1f s: %zu chunks resident (%.1f MB), %zu queued, %llu generated (+%llu)\n",
+				tick * Simulation::TickDuration, stats.ResidentChunks, ToMB(stats.ResidentBytes), stats.QueueLength,
+				static_cast<unsigned long long>(stats.Generated), static_cast<unsigned long long>(stats.Generated - reportedGenerated));
+			reportedGenerated = stats.Generated;
+			nextReport = now + std::chrono::seconds(1);
+		}
+		const Clock::time_point due = start + ((tick + 1) * tickDuration);
+		if (now > due) {
+			++lateTicks;
+		} else {
+			std::this_thread::sleep_until(due);
+		}
+	}
+	const float elapsed = std::chrono::duration<float>(Clock::now() - start).count();
+
+	// Take the numbers while the observers still hold their chunks
+	WorldServerStats stats = server.GetStats();
+#ifdef NIRNIA_TRACK_MEMORY
+	MemoryTracker::Snapshot memory = MemoryTracker::GetSnapshot();
+#endif
+	size_t stillWaiting = 0;
+	for (Observer& observer : observers) {
+		stillWaiting += observer.Pending.size();
+		LeaveWindow(server, observer, options.Radius);
+	}
+	server.Stop();
+
+	std::printf("Ran %.1f s of simulated time in %.1f s.  Observer updates kept this thread %.0f%% busy, %llu of %llu ticks ran late\n",
+		ticks * Simulation::TickDuration, elapsed, 100.0f * std::chrono::duration<float>(busyTime).count() / elapsed,
+		static_cast<unsigned long long>(lateTicks), static_cast<unsigned long long>(ticks));
+	std::printf("Requests: %llu.  %.1f%% already resident, %llu (%.1f%%) coalesced with a request already in hand\n",
+		static_cast<unsigned long long>(stats.Requests), stats.Requests ? 100.0 * stats.Hits / stats.Requests : 0.0,
+		static_cast<unsigned long long>(stats.Coalesced), stats.Requests ? 100.0 * stats.Coalesced / stats.Requests : 0.0);
+	std::printf("Generated %llu chunks: %.1f per second, %.2f ms each, generator threads %.0f%% busy.  Max queue length %zu\n",
+		static_cast<unsigned long long>(stats.Generated), stats.Generated / elapsed,
+		(stats.Generated + stats.Discarded) ? stats.GenerationTime / (stats.Generated + stats.Discarded) : 0.0,
+		stats.GenerationTime / (10.0f * elapsed * options.Threads), stats.MaxQueueLength);
+	std::printf("Released before use: %llu cancelled while queued, %llu discarded after generation.  %llu evicted\n",
+		static_cast<unsigned long long>(stats.Cancelled), static_cast<unsigned long long>(stats.Discarded), static_cast<unsigned long long>(stats.Evicted));
+
+	const size_t waits = waitTimes.size();
+	const float p50 = GetPercentile(waitTimes, 0.5f);
+	const float p90 = GetPercentile(waitTimes, 0.9f);
+	const float p99 = GetPercentile(waitTimes, 0.99f);
+	const float maxWait = GetPercentile(waitTimes, 1.0f);
+	std::printf("Time to chunk (ms, over %zu chunks that had to be waited for): p50 %.1f, p90 %.1f, p99 %.1f, max %.1f.  %zu still waiting at the end\n",
+		waits, p50, p90, p99, maxWait, stillWaiting);
+
+	std::vector<float> meanWaits;
+	std::vector<float> stallTimes;
+	for (const Observer& observer : observers) {
+		if (observer.Waits) {
+			meanWaits.push_back(static_cast<float>(observer.WaitTime / observer.Waits));
+		}
+		stallTimes.push_back(observer.StallTicks * Simulation::TickDuration);
+	}
+	const size_t stalled = std::count_if(stallTimes.begin(), stallTimes.end(), [](const float time) { return time > 0.0f; });
+	std::printf("Per observer: mean time to chunk (ms) median %.1f, worst %.1f.  %zu stood in a missing chunk, worst for %.2f s\n",
+		GetPercentile(meanWaits, 0.5f), GetPercentile(meanWaits, 1.0f), stalled, GetPercentile(stallTimes, 1.0f));
+
+	std::printf("Resident chunks: %zu at the end, %zu peak.  %.1f MB at the end, %.1f MB peak (%.1f KB per chunk)\n",
+		stats.ResidentChunks, stats.PeakResidentChunks, ToMB(stats.ResidentBytes), ToMB(stats.PeakResidentBytes),
+		stats.ResidentChunks ? stats.ResidentBytes / (1024.0f * stats.ResidentChunks) : 0.0f);
+#ifdef NIRNIA_TRACK_MEMORY
+	for (const MemoryTag tag : {MemoryTag::ChunkGround, MemoryTag::ChunkTrees, MemoryTag::ChunkLayers, MemoryTag::Untagged}) {
+		const MemoryTracker::TagStats& tagStats = memory.Tags[static_cast<int>(tag)];
+		std::printf("  %-12s %8.1f MB live, %8.1f MB peak\n", MemoryTracker::GetTagName(tag), ToMB(tagStats.LiveBytes), ToMB(tagStats.PeakBytes));
+	}
+#endif
+
+	if (!options.Csv.empty()) {
+		if (!WriteCsv(options.Csv, observers)) {
+			std::printf("Could not write '%s'\n", options.Csv.c_str());
+			return false;
+		}
+		std::printf("Wrote per-observer results to '%s'\n", options.Csv.c_str());
+	}
+	return true;
+}
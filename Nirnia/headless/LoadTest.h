@@ -0,0 +1,32 @@
+#pragma once
+
+#include "WorldGenerator.h"
+
+#include <cstdint>
+#include <string>
+
+// Settings for a load test of the WorldServer: many observers, moving about the world at once, each keeping the
+// chunks around it resident.
+//
+// Observers move at the simulation's tick rate, in real time (or faster, with TimeScale).  Each either wanders between
+// random waypoints, or replays a recording of the player's input.  They are not blocked by the terrain (the
+// headless tools have no pathfinding), so a replay covers the same ground as the recording only until the player
+// first bumped into something.
+struct LoadTestOptions {
+	uint32_t Observers = 100;
+	uint32_t Threads = 1;            // generator threads
+	int ChunkSize = 32;              // tiles
+	int Radius = 1;                  // each observer holds the chunks within this many chunks of its own
+	float Duration = 30.0f;          // seconds (of simulated time)
+	float TimeScale = 1.0f;          // simulated seconds per real second
+	float Speed = 1.5f;              // tiles per second, for wandering observers
+	float Spread = 1000.0f;          // observers start at random positions up to this many tiles from the origin
+	float Stagger = 0.0f;            // seconds between one observer joining and the next
+	uint32_t Seed = 1;
+	std::string Replay;              // if set, observers replay this input recording rather than wandering
+	std::string Csv;                 // if set, per-observer results are written here
+};
+
+
+// Runs the test, printing progress and a report to stdout.  Returns false (having printed why) if it could not be run.
+bool RunLoadTest(const WorldGenerator& generator, const LoadTestOptions& options);
@@ -0,0 +1,78 @@
+#include "RegionHash.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+	// 2: chunks generated with the game's one tile border (version 1 manifests left each chunk's bottom row and left
+	// column unchecked)
+	constexpr int ManifestVersion = 2;
+
+}
+
+
+std::vector<ChunkHashEntry> HashRegion(const WorldGenerator& generator, const ReferenceRegion& region, const uint32_t numThreads) {
+	const int size = 2 * region.Radius;
+	std::vector<ChunkHashEntry> hashes(static_cast<size_t>(size) * size);
+
+	// Threads take chunks from a shared counter.  Each chunk's hash goes in its own entry, so the result is in the
+	// same order however the work is split up.
+	std::atomic<size_t> next = 0;
+	auto worker = [&]() {
+		Chunk chunk;
+		for (size_t n = next++; n < hashes.size(); n = next++) {
+			int i = static_cast<int>(n % size) - region.Radius;
+			int j = static_cast<int>(n / size) - region.Radius;
+			generator.Generate((i * region.ChunkSize) - 1, (j * region.ChunkSize) - 1, region.ChunkSize + 1, region.ChunkSize + 1, chunk);
+			hashes[n] = {i, j, HashChunk(chunk)};
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (uint32_t t = 1; t < numThreads; ++t) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	return hashes;
+}
+
+
+bool SaveManifest(const std::string& path, const ReferenceRegion& region, const std::vector<ChunkHashEntry>& hashes) {
+	std::ofstream file(path);
+	if (!file) {
+		return false;
+	}
+	file << "nirnia-chunk-hashes " << ManifestVersion << " " << region.ChunkSize << " " << region.Radius << "\n";
+	for (const ChunkHashEntry& entry : hashes) {
+		char hash[17];
+		std::snprintf(hash, sizeof(hash), "%016" PRIx64, entry.Hash);
+		file << entry.I << " " << entry.J << " " << hash << "\n";
+	}
+	return static_cast<bool>(file);
+}
+
+
+bool LoadManifest(const std::string& path, ReferenceRegion& region, std::vector<ChunkHashEntry>& hashes) {
+	std::ifstream file(path);
+	std::string magic;
+	int version;
+	if (!(file >> magic >> version >> region.ChunkSize >> region.Radius) || (magic != "nirnia-chunk-hashes") || (version != ManifestVersion)) {
+		return false;
+	}
+	hashes.clear();
+	ChunkHashEntry entry;
+	std::string hash;
+	while (file >> entry.I >> entry.J >> hash) {
+		entry.Hash = std::stoull(hash, nullptr, 16);
+		hashes.push_back(entry);
+	}
+	return true;
+}
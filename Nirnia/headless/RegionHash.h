@@ -0,0 +1,34 @@
+#pragma once
+
+#include "WorldGenerator.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A square block of chunks, centred on the origin, that is generated and hashed to check the generator's output.
+// Chunks are laid out as the game lays them out: ChunkSize x ChunkSize tiles, not overlapping, with chunk (i, j)
+// covering tiles [i * ChunkSize, (i + 1) * ChunkSize) in x (and likewise in y).  Each is generated with a border of one
+// tile below and to the left, so that every tile it covers has its corners, and is checked.
+struct ReferenceRegion {
+	int ChunkSize = 64;
+	int Radius = 4;         // chunks [-Radius, Radius) in each direction
+};
+
+
+struct ChunkHashEntry {
+	int I;
+	int J;
+	uint64_t Hash;
+
+	bool operator==(const ChunkHashEntry& other) const { return (I == other.I) && (J == other.J) && (Hash == other.Hash); }
+	bool operator!=(const ChunkHashEntry& other) const { return !(*this == other); }
+};
+
+
+// Generates every chunk in the region (spread over given number of threads) and returns their hashes, in row order
+std::vector<ChunkHashEntry> HashRegion(const WorldGenerator& generator, const ReferenceRegion& region, const uint32_t numThreads);
+
+// Manifest is a text file: a header line giving the (format version and) region, followed by "i j hash" for each chunk
+bool SaveManifest(const std::string& path, const ReferenceRegion& region, const std::vector<ChunkHashEntry>& hashes);
+bool LoadManifest(const std::string& path, ReferenceRegion& region, std::vector<ChunkHashEntry>& hashes);
@@ -0,0 +1,176 @@
+#include "WorldServer.h"
+
+#include <algorithm>
+
+namespace {
+
+	size_t GetChunkBytes(const Chunk& chunk) {
+		return sizeof(Chunk) +
+			(chunk.GroundType.capacity() * sizeof(ChunkGround::value_type)) +
+			(chunk.Trees.capacity() * sizeof(ChunkTrees::value_type)) +
+			(chunk.Layers.capacity() * sizeof(ChunkLayers::value_type));
+	}
+
+}
+
+
+WorldServer::WorldServer(const WorldGenerator& generator, const int chunkSize)
+: m_Generator(generator)
+, m_ChunkSize(chunkSize)
+{}
+
+
+WorldServer::~WorldServer() {
+	Stop();
+}
+
+
+void WorldServer::Start(const uint32_t numThreads) {
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Stopping = false;
+	}
+	for (uint32_t t = 0; t < numThreads; ++t) {
+		m_Threads.emplace_back(&WorldServer::Generate, this);
+	}
+}
+
+
+void WorldServer::Stop() {
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_QueueCondition.notify_all();
+	for (std::thread& thread : m_Threads) {
+		thread.join();
+	}
+	m_Threads.clear();
+}
+
+
+bool WorldServer::Acquire(const int i, const int j) {
+	const uint64_t key = GetKey(i, j);
+	bool queued = false;
+	bool resident = false;
+	{
+		std::lock_guard lock(m_Mutex);
+		++m_Stats.Requests;
+		auto [it, inserted] = m_Chunks.try_emplace(key);
+		Entry& entry = it->second;
+		if (inserted) {
+			m_Queue.push_back(key);
+			m_Stats.MaxQueueLength = std::max(m_Stats.MaxQueueLength, ++m_Stats.QueueLength);
+			queued = true;
+		} else if (entry.State == ChunkState::Resident) {
+			++m_Stats.Hits;
+			resident = true;
+		} else {
+			++m_Stats.Coalesced;
+		}
+		++entry.References;
+	}
+	if (queued) {
+		m_QueueCondition.notify_one();
+	}
+	return resident;
+}
+
+
+void WorldServer::Release(const int i, const int j) {
+	std::shared_ptr<const Chunk> evicted;  // (freed outside of the lock)
+	std::lock_guard lock(m_Mutex);
+	auto it = m_Chunks.find(GetKey(i, j));
+	if ((it == m_Chunks.end()) || (it->second.References == 0) || (--it->second.References > 0)) {
+		return;
+	}
+	switch (it->second.State) {
+		case ChunkState::Queued:
+			// the key stays in the queue, and is skipped when the generator gets to it
+			--m_Stats.QueueLength;
+			++m_Stats.Cancelled;
+			m_Chunks.erase(it);
+			break;
+		case ChunkState::Generating:
+			// the generator drops the chunk when it is done (unless it has been acquired again by then)
+			break;
+		case ChunkState::Resident:
+			evicted = std::move(it->second.Data);
+			m_Stats.ResidentBytes -= GetChunkBytes(*evicted);
+			--m_Stats.ResidentChunks;
+			++m_Stats.Evicted;
+			m_Chunks.erase(it);
+			break;
+	}
+}
+
+
+bool WorldServer::GetReadyTime(const int i, const int j, Clock::time_point& readyTime) const {
+	std::lock_guard lock(m_Mutex);
+	auto it = m_Chunks.find(GetKey(i, j));
+	if ((it == m_Chunks.end()) || (it->second.State != ChunkState::Resident)) {
+		return false;
+	}
+	readyTime = it->second.ReadyTime;
+	return true;
+}
+
+
+std::shared_ptr<const Chunk> WorldServer::Find(const int i, const int j) const {
+	std::lock_guard lock(m_Mutex);
+	auto it = m_Chunks.find(GetKey(i, j));
+	return (it != m_Chunks.end()) ? it->second.Data : nullptr;
+}
+
+
+WorldServerStats WorldServer::GetStats() const {
+	std::lock_guard lock(m_Mutex);
+	return m_Stats;
+}
+
+
+void WorldServer::Generate() {
+	for (;;) {
+		uint64_t key;
+		{
+			std::unique_lock lock(m_Mutex);
+			m_QueueCondition.wait(lock, [this] { return m_Stopping || !m_Queue.empty(); });
+			if (m_Stopping) {
+				return;
+			}
+			key = m_Queue.front();
+			m_Queue.pop_front();
+			auto it = m_Chunks.find(key);
+			if ((it == m_Chunks.end()) || (it->second.State != ChunkState::Queued)) {
+				continue;
+			}
+			it->second.State = ChunkState::Generating;
+			--m_Stats.QueueLength;
+		}
+
+		const int i = static_cast<int32_t>(key >> 32);
+		const int j = static_cast<int32_t>(key & 0xFFFFFFFF);
+		auto start = Clock::now();
+		auto chunk = std::make_shared<Chunk>();
+		m_Generator.Generate((i * m_ChunkSize) - 1, (j * m_ChunkSize) - 1, m_ChunkSize + 1, m_ChunkSize + 1, *chunk);
+		auto now = Clock::now();
+		const size_t bytes = GetChunkBytes(*chunk);
+
+		std::shared_ptr<const Chunk> discarded;  // (freed outside of the lock)
+		std::lock_guard lock(m_Mutex);
+		m_Stats.GenerationTime += std::chrono::duration<double, std::milli>(now - start).count();
+		auto it = m_Chunks.find(key);
+		if (it->second.References == 0) {
+			discarded = std::move(chunk);
+			++m_Stats.Discarded;
+			m_Chunks.erase(it);
+			continue;
+		}
+		it->second.State = ChunkState::Resident;
+		it->second.Data = std::move(chunk);
+		it->second.ReadyTime = now;
+		++m_Stats.Generated;
+		m_Stats.PeakResidentChunks = std::max(m_Stats.PeakResidentChunks, ++m_Stats.ResidentChunks);
+		m_Stats.PeakResidentBytes = std::max(m_Stats.PeakResidentBytes, m_Stats.ResidentBytes += bytes);
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "WorldGenerator.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Counters for a WorldServer
+struct WorldServerStats {
+	uint64_t Requests = 0;           // Acquire() calls
+	uint64_t Hits = 0;               // ... for chunks that were already resident
+	uint64_t Coalesced = 0;          // ... for chunks that were already queued or being generated
+	uint64_t Generated = 0;          // chunks generated and made resident
+	uint64_t Cancelled = 0;          // queued chunks released before generation started
+	uint64_t Discarded = 0;          // chunks released while being generated (the work is thrown away)
+	uint64_t Evicted = 0;            // resident chunks released
+	double GenerationTime = 0.0;     // total milliseconds spent generating chunks (over all threads)
+	size_t QueueLength = 0;          // chunks waiting for a generator thread
+	size_t MaxQueueLength = 0;
+	size_t ResidentChunks = 0;
+	size_t PeakResidentChunks = 0;
+	size_t ResidentBytes = 0;        // chunk content (ground, trees and layers)
+	size_t PeakResidentBytes = 0;
+};
+
+
+// The world as shared by many observers: one store of chunks, filled by a pool of generator threads.
+//
+// Observers Acquire() the chunks they need and Release() them when they move on.  A chunk stays resident for as long
+// as anyone holds it (residency is reference counted), and is dropped as soon as nobody does.  A chunk asked for
+// while it is already queued or being generated is not generated again: the request just adds to its count.
+//
+// Chunks have the game's layout: chunk (i, j) is tiles [i * size, (i + 1) * size) x [j * size, (j + 1) * size),
+// generated with a border of one tile below and to the left.
+//
+// All member functions can be called from any thread.
+class WorldServer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	WorldServer(const WorldGenerator& generator, const int chunkSize);
+	~WorldServer();
+
+	void Start(const uint32_t numThreads);
+
+	// Waits for chunks being generated, and abandons those still queued
+	void Stop();
+
+	int GetChunkSize() const { return m_ChunkSize; }
+
+	// Adds a reference to chunk (i, j), and queues it for generation if it is not resident (or on its way).
+	// Returns true if the chunk is resident already.
+	bool Acquire(const int i, const int j);
+
+	// Drops a reference taken by Acquire()
+	void Release(const int i, const int j);
+
+	// If chunk (i, j) is resident, sets readyTime to when it became so, and returns true
+	bool GetReadyTime(const int i, const int j, Clock::time_point& readyTime) const;
+
+	// Returns chunk (i, j) if it is resident, otherwise null
+	std::shared_ptr<const Chunk> Find(const int i, const int j) const;
+
+	WorldServerStats GetStats() const;
+
+private:
+	enum class ChunkState : uint8_t {
+		Queued,
+		Generating,
+		Resident
+	};
+
+	// A chunk that is wanted (References > 0), or that is being generated (and may have been released since)
+	struct Entry {
+		uint32_t References = 0;
+		ChunkState State = ChunkState::Queued;
+		std::shared_ptr<const Chunk> Data;
+		Clock::time_point ReadyTime;
+	};
+
+	static uint64_t GetKey(const int i, const int j) { return (static_cast<uint64_t>(static_cast<uint32_t>(i)) << 32) | static_cast<uint32_t>(j); }
+
+	void Generate();
+
+private:
+	const WorldGenerator& m_Generator;
+	const int m_ChunkSize;
+
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_QueueCondition;
+	std::unordered_map<uint64_t, Entry> m_Chunks;
+	std::deque<uint64_t> m_Queue;    // may hold keys whose chunks have since been released (or queued again), which the generator skips
+	bool m_Stopping = false;
+	WorldServerStats m_Stats;
+
+	std::vector<std::thread> m_Threads;
+};
@@ -46,6 +46,79 @@ project "Nirnia"
 		defines
 		{
 			"HZ_PROFILE",
+			"NIRNIA_TRACK_MEMORY",
+			"TRACY_ENABLE"
+		}
+		runtime "Release"
+		optimize "on"
+
+	filter "configurations:Release"
+		defines "HZ_RELEASE"
+		runtime "Release"
+		optimize "on"
+
+
+project "NirniaHeadless"
+	location "."  -- (so that paths such as the golden manifest are relative to the project dir, as for Nirnia)
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+	files
+	{
+		"headless/**.h",
+		"headless/**.cpp",
+		"src/Chunk.h",
+		"src/Chunk.cpp",
+		"src/InputReplay.h",
+		"src/InputReplay.cpp",
+		"src/MemoryTracking.h",
+		"src/MemoryTracking.cpp",
+		"src/Random.h",
+		"src/Random.cpp",
+		"src/TerrainGraph.h",
+		"src/TerrainGraph.cpp",
+		"src/Tree.h",
+		"src/WorldGenerator.h",
+		"src/WorldGenerator.cpp",
+		"vendor/FastNoise/FastNoise.cpp"
+	}
+
+	defines {
+		"_SILENCE_CXX17_RESULT_OF_DEPRECATION_WARNING"
+	}
+
+	includedirs
+	{
+		"src",
+		"headless",
+		"../Hazel/Hazel/src",
+		"../Hazel/Hazel/vendor/glm",
+		"../Hazel/Hazel/vendor/spdlog/include",
+		"vendor/FastNoise"
+	}
+
+	links {
+		"Hazel"
+	}
+
+	filter "system:windows"
+		systemversion "latest"
+
+	filter "configurations:Debug"
+		defines "HZ_DEBUG"
+		runtime "Debug"
+		symbols "on"
+
+	filter "configurations:Profile"
+		defines
+		{
+			"HZ_PROFILE",
+			"NIRNIA_TRACK_MEMORY",
 			"TRACY_ENABLE"
 		}
 		runtime "Release"
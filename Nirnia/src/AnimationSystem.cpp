@@ -0,0 +1,149 @@
+#include "AnimationSystem.h"
+
+AnimationSystem::AnimationSystem(const uint8_t numClips, const uint8_t ticksPerFrame)
+: m_ClipOffset(numClips, 0)
+, m_ClipLength(numClips, 1)
+, m_IsIdle(numClips, 0)
+, m_BlinkClip(numClips)
+, m_NoBlinkClip(numClips)
+, m_FootTapClip(numClips)
+, m_TicksPerFrame(ticksPerFrame)
+{
+	// every clip starts out as a single frame showing sprite 0
+	m_Frames.push_back(0);
+	for (uint8_t clip = 0; clip < numClips; ++clip) {
+		m_BlinkClip[clip] = clip;
+		m_NoBlinkClip[clip] = clip;
+		m_FootTapClip[clip] = clip;
+	}
+}
+
+
+void AnimationSystem::SetClip(const uint8_t clip, const std::vector<uint8_t>& frames) {
+	m_ClipOffset[clip] = static_cast<uint16_t>(m_Frames.size());
+	m_ClipLength[clip] = static_cast<uint8_t>(frames.size());
+	m_Frames.insert(m_Frames.end(), frames.begin(), frames.end());
+}
+
+
+void AnimationSystem::SetIdleTransitions(const uint8_t clip, const uint8_t blinkClip, const uint8_t noBlinkClip, const uint8_t footTapClip) {
+	m_IsIdle[clip] = 1;
+	m_BlinkClip[clip] = blinkClip;
+	m_NoBlinkClip[clip] = noBlinkClip;
+	m_FootTapClip[clip] = footTapClip;
+}
+
+
+uint32_t AnimationSystem::AddActor(const uint8_t clip, const int chunkI, const int chunkJ, const uint32_t seed) {
+	m_Clip.push_back(clip);
+	m_Frame.push_back(0);
+	m_Timer.push_back(static_cast<uint8_t>(seed % m_TicksPerFrame)); // stagger timers, so that actors don't all change frame on the same tick
+	m_Sprite.push_back(m_Frames[m_ClipOffset[clip]]);
+	m_RandomState.push_back((seed * 2654435761u) | 1);  // xorshift state must never be zero
+	m_ChunkI.push_back(chunkI);
+	m_ChunkJ.push_back(chunkJ);
+	m_Active.push_back(IsInWindow(chunkI, chunkJ));
+	m_Advancing.push_back(0);
+	return static_cast<uint32_t>(m_Clip.size() - 1);
+}
+
+
+void AnimationSystem::RemoveActors(const uint32_t firstActor) {
+	if (firstActor < m_Clip.size()) {
+		m_Clip.resize(firstActor);
+		m_Frame.resize(firstActor);
+		m_Timer.resize(firstActor);
+		m_Sprite.resize(firstActor);
+		m_RandomState.resize(firstActor);
+		m_ChunkI.resize(firstActor);
+		m_ChunkJ.resize(firstActor);
+		m_Active.resize(firstActor);
+		m_Advancing.resize(firstActor);
+	}
+}
+
+
+void AnimationSystem::SetActorClip(const uint32_t actor, const uint8_t clip) {
+	m_Clip[actor] = clip;
+	m_Frame[actor] = 0;
+	m_Sprite[actor] = m_Frames[m_ClipOffset[clip]];
+}
+
+
+void AnimationSystem::SetActorChunk(const uint32_t actor, const int chunkI, const int chunkJ) {
+	m_ChunkI[actor] = chunkI;
+	m_ChunkJ[actor] = chunkJ;
+	m_Active[actor] = IsInWindow(chunkI, chunkJ);
+}
+
+
+void AnimationSystem::Update(const int minI, const int minJ, const int maxI, const int maxJ) {
+	const size_t count = m_Clip.size();
+
+	// Work out which actors are in the window.  The window only changes when the player moves to another chunk,
+	// so most of the time there is nothing to do here.
+	if ((minI != m_WindowMinI) || (minJ != m_WindowMinJ) || (maxI != m_WindowMaxI) || (maxJ != m_WindowMaxJ)) {
+		m_WindowMinI = minI;
+		m_WindowMinJ = minJ;
+		m_WindowMaxI = maxI;
+		m_WindowMaxJ = maxJ;
+		for (size_t a = 0; a < count; ++a) {
+			m_Active[a] = IsInWindow(m_ChunkI[a], m_ChunkJ[a]);
+		}
+	}
+
+	// Pass 1: advance every actor's timer, and make a list of the actors that move on to their next frame.
+	// Frozen actors have zero time added to their timer.
+	// Everything is written as selects rather than branches, so that the loop body is the same for every actor.
+	const uint8_t ticksPerFrame = m_TicksPerFrame;
+	const uint8_t* __restrict active = m_Active.data();
+	uint8_t* __restrict timers = m_Timer.data();
+	uint32_t* __restrict advancing = m_Advancing.data();
+	size_t numAdvancing = 0;
+	for (size_t a = 0; a < count; ++a) {
+		const uint32_t timer = timers[a] + active[a];
+		const uint32_t advance = timer >= ticksPerFrame;
+		timers[a] = static_cast<uint8_t>(timer * (1 - advance));
+		advancing[numAdvancing] = static_cast<uint32_t>(a);
+		numAdvancing += advance;
+	}
+
+	// Pass 2: move actors on to their next frame, changing idle clips when they loop back to the first frame.
+	// Timers are staggered when actors are added, so this is only a fraction of the actors on any given tick.
+	const uint8_t* frames = m_Frames.data();
+	const uint16_t* clipOffset = m_ClipOffset.data();
+	const uint8_t* clipLength = m_ClipLength.data();
+	const uint8_t* isIdle = m_IsIdle.data();
+	const uint8_t* blinkClip = m_BlinkClip.data();
+	const uint8_t* noBlinkClip = m_NoBlinkClip.data();
+	const uint8_t* footTapClip = m_FootTapClip.data();
+	uint8_t* __restrict clips = m_Clip.data();
+	uint8_t* __restrict frameIndex = m_Frame.data();
+	uint8_t* __restrict sprites = m_Sprite.data();
+	uint32_t* __restrict randomState = m_RandomState.data();
+	for (size_t n = 0; n < numAdvancing; ++n) {
+		const uint32_t a = advancing[n];
+		const uint32_t clip = clips[a];
+		uint32_t frame = frameIndex[a] + 1;
+		frame *= (frame < clipLength[clip]);
+
+		const uint32_t loop = (frame == 0) & isIdle[clip];
+		uint32_t random = randomState[a];
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		randomState[a] = loop ? random : randomState[a];
+		const uint32_t blink = ((random >> 24) < 64) ? blinkClip[clip] : noBlinkClip[clip];
+		const uint32_t tap = (((random >> 16) & 7) == 0) ? footTapClip[blink] : blink;
+		const uint32_t newClip = loop ? tap : clip;
+
+		clips[a] = static_cast<uint8_t>(newClip);
+		frameIndex[a] = static_cast<uint8_t>(frame);
+		sprites[a] = frames[clipOffset[newClip] + frame];
+	}
+}
+
+
+uint8_t AnimationSystem::IsInWindow(const int chunkI, const int chunkJ) const {
+	return (chunkI >= m_WindowMinI) & (chunkI <= m_WindowMaxI) & (chunkJ >= m_WindowMinJ) & (chunkJ <= m_WindowMaxJ);
+}
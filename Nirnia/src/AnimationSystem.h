@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Data oriented sprite animation, for large numbers of actors.
+//
+// Animation clips are stored in flat tables (all clip frames back to back, plus an offset and length per clip).
+// Per-actor state is held in parallel arrays (structure of arrays).  Each update is a branch free pass over the
+// actor timers (which the compiler is free to vectorize) that also collects the actors due a new frame, followed
+// by a (also branch free) pass over just those actors.
+//
+// Idle clips can be set up to change into another clip each time they loop (e.g. the player blinks, and taps
+// their foot).  The choice is made with a per-actor random number generator, so the result depends only on the
+// actor's seed and the number of ticks it has been updated for.
+//
+// Actors are tagged with the chunk they are in.  Update() only advances actors in a given window of chunks,
+// actors outside the window are frozen.
+class AnimationSystem
+{
+public:
+	AnimationSystem(const uint8_t numClips, const uint8_t ticksPerFrame);
+
+	// Defines the sprites making up an animation clip.  frames must not be empty.
+	void SetClip(const uint8_t clip, const std::vector<uint8_t>& frames);
+
+	// Defines what happens when an idle clip loops. The clip changes to blinkClip (25% of the time) or noBlinkClip,
+	// and then 1 in 8 of the time to whatever footTapClip is set for that clip.
+	// Clips that have never had their idle transitions set just loop.
+	void SetIdleTransitions(const uint8_t clip, const uint8_t blinkClip, const uint8_t noBlinkClip, const uint8_t footTapClip);
+
+	// Adds an actor, playing given clip from the first frame.  Returns the actor id.
+	uint32_t AddActor(const uint8_t clip, const int chunkI, const int chunkJ, const uint32_t seed);
+
+	// Removes all actors with id >= firstActor
+	void RemoveActors(const uint32_t firstActor);
+
+	// Changes the clip an actor is playing.  The clip restarts from the first frame.
+	void SetActorClip(const uint32_t actor, const uint8_t clip);
+
+	void SetActorChunk(const uint32_t actor, const int chunkI, const int chunkJ);
+
+	uint8_t GetActorClip(const uint32_t actor) const { return m_Clip[actor]; }
+	uint8_t GetActorFrame(const uint32_t actor) const { return m_Frame[actor]; }
+	uint8_t GetActorSprite(const uint32_t actor) const { return m_Sprite[actor]; }
+
+	// Current sprite for every actor, indexed by actor id
+	const std::vector<uint8_t>& GetSprites() const { return m_Sprite; }
+
+	uint32_t GetActorCount() const { return static_cast<uint32_t>(m_Clip.size()); }
+
+	// Advances all actors in chunks [minI, maxI] x [minJ, maxJ] by one tick
+	void Update(const int minI, const int minJ, const int maxI, const int maxJ);
+
+private:
+	uint8_t IsInWindow(const int chunkI, const int chunkJ) const;
+
+private:
+	// Clip tables
+	std::vector<uint8_t> m_Frames;          // sprites for all clips, back to back
+	std::vector<uint16_t> m_ClipOffset;     // index of first frame in m_Frames
+	std::vector<uint8_t> m_ClipLength;      // number of frames
+	std::vector<uint8_t> m_IsIdle;          // 1 => clip changes when it loops (per the following tables), 0 => clip just loops
+	std::vector<uint8_t> m_BlinkClip;
+	std::vector<uint8_t> m_NoBlinkClip;
+	std::vector<uint8_t> m_FootTapClip;
+	uint8_t m_TicksPerFrame;
+
+	// Per-actor state
+	std::vector<uint8_t> m_Clip;
+	std::vector<uint8_t> m_Frame;
+	std::vector<uint8_t> m_Timer;           // ticks since the actor last advanced a frame
+	std::vector<uint8_t> m_Sprite;
+	std::vector<uint32_t> m_RandomState;    // xorshift32
+	std::vector<int32_t> m_ChunkI;
+	std::vector<int32_t> m_ChunkJ;
+	std::vector<uint8_t> m_Active;          // 1 => actor is in the current update window
+	std::vector<uint32_t> m_Advancing;      // scratch space: actors that move on to their next frame this tick
+
+	// Update window
+	int m_WindowMinI = 0;
+	int m_WindowMinJ = 0;
+	int m_WindowMaxI = -1;
+	int m_WindowMaxJ = -1;
+};
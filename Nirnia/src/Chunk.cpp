@@ -0,0 +1,45 @@
+#include "Chunk.h"
+
+namespace {
+
+	// 64 bit FNV-1a
+	constexpr uint64_t FNVOffsetBasis = 14695981039346656037ull;
+	constexpr uint64_t FNVPrime = 1099511628211ull;
+
+	inline void HashByte(uint64_t& hash, const uint8_t byte) {
+		hash = (hash ^ byte) * FNVPrime;
+	}
+
+	// Multi-byte values are hashed least significant byte first, so that the hash doesn't depend on the platform
+	inline void HashUInt16(uint64_t& hash, const uint16_t value) {
+		HashByte(hash, static_cast<uint8_t>(value));
+		HashByte(hash, static_cast<uint8_t>(value >> 8));
+	}
+
+	inline void HashUInt32(uint64_t& hash, const uint32_t value) {
+		HashUInt16(hash, static_cast<uint16_t>(value));
+		HashUInt16(hash, static_cast<uint16_t>(value >> 16));
+	}
+
+}
+
+
+uint64_t HashChunk(const Chunk& chunk) {
+	uint64_t hash = FNVOffsetBasis;
+
+	// Lengths are included, so that content can't "move" from one section to the other without changing the hash
+	HashUInt32(hash, static_cast<uint32_t>(chunk.GroundType.size()));
+	for (uint8_t groundType : chunk.GroundType) {
+		HashByte(hash, groundType);
+	}
+
+	HashUInt32(hash, static_cast<uint32_t>(chunk.Trees.size()));
+	for (const Tree& tree : chunk.Trees) {
+		HashUInt16(hash, tree.X);
+		HashUInt16(hash, tree.Y);
+		HashByte(hash, tree.Scale);
+		HashByte(hash, static_cast<uint8_t>(tree.Kind));
+	}
+
+	return hash;
+}
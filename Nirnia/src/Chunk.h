@@ -0,0 +1,68 @@
+#pragma once
+
+#include "MemoryTracking.h"
+#include "Tree.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using ChunkGround = std::vector<uint8_t, TaggedAllocator<uint8_t, MemoryTag::ChunkGround>>;
+using ChunkTrees = std::vector<Tree, TaggedAllocator<Tree, MemoryTag::ChunkTrees>>;
+using ChunkLayers = std::vector<float, TaggedAllocator<float, MemoryTag::ChunkLayers>>;
+
+// Largest chunk size (in tiles) that the game offers.  Chunks are generated with a one tile border, and tree positions
+// within a chunk are stored in 8.8 fixed point (see PackTree()), so a chunk can be no more than 255 tiles across.
+constexpr int MaxChunkSize = 128;
+
+
+// Water (any ground type <= 39) cannot be walked on.  Nor can the tile that a blocking tree stands on (see TreeKindInfo).
+inline bool IsWalkableGround(const uint8_t groundType) {
+	return groundType > 39;
+}
+
+
+// The generated content of one map chunk.
+// Chunks are built on the chunk generator thread and are immutable once published.
+struct Chunk {
+	ChunkGround GroundType;
+	ChunkTrees Trees;
+
+	// Intermediate results of generation, kept (if the generator is asked to keep them, i.e. while the terrain is being
+	// tuned) so that the chunk can be brought up to date with a change to the terrain without redoing the work the
+	// change does not affect
+	ChunkLayers Layers;
+	uint64_t LayersVersion = 0;      // terrain version that Layers are up to date with (0 => none)
+};
+
+
+// Canonical hash of a chunk's content (ground types, and the quantized tree records).
+// Two chunks hash the same if and only if (barring collisions) they would draw identically, so this can be used to
+// check that changes to the generator (or to how it is run) have not changed the world.
+uint64_t HashChunk(const Chunk& chunk);
+
+
+// A request for the chunk generator to (re)generate chunk (I, J).
+// Generation is the ChunkGrid slot generation at the time the request was made.  If the slot has been recycled
+// by the time the generator gets to the request, then the request is stale and is dropped.
+// Regenerate => the chunk is being brought up to date with a change to the terrain, and the generator builds on its
+// current content (if it has any yet).
+struct ChunkRequest {
+	int I;
+	int J;
+	uint32_t Generation;
+	bool Regenerate = false;
+};
+
+
+// Counters for the chunk streaming pipeline
+struct ChunkStats {
+	uint64_t Requested = 0;          // chunks submitted for generation
+	uint64_t Generated = 0;          // chunks generated and published
+	uint64_t Dropped = 0;            // requests that went stale (slot recycled before or during generation)
+	size_t MaxQueueLength = 0;       // most requests waiting at any one time
+	double GenerationTime = 0.0;     // total milliseconds spent generating chunks
+	float MaxGenerationTime = 0.0f;  // milliseconds taken by the slowest chunk
+	uint64_t Regenerated = 0;        // chunks brought up to date with a terrain change (not counted in the above)
+	double RegenerationTime = 0.0;   // total milliseconds spent on those
+};
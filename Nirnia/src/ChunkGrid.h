@@ -0,0 +1,160 @@
+#pragma once
+
+#include "MemoryTracking.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+// Fixed size 2D ring buffer of chunk slots.
+//
+// Chunk (i, j) always lives in slot (i mod N, j mod N), where N is the smallest power of two that can hold a
+// (2 * radius + 1) square window of chunks.  Lookup is therefore a couple of masks and a compare, and moving the
+// window around never moves any data: the slots that fall out of the window are simply claimed by the chunks
+// coming into it.
+//
+// Each slot carries a generation tag which is bumped every time the slot is claimed for a different chunk.
+// Work queued against a slot (e.g. chunk generation on a worker thread) remembers the generation it was queued
+// for, and uses it to detect that the slot has since been recycled (in which case the result is stale, and is
+// thrown away).
+//
+// ChunkGrid does no synchronization of its own.  Callers are expected to hold whatever lock protects the grid.
+// Slot storage is accounted to Tag (when memory tracking is compiled in).
+template<typename T, MemoryTag Tag = MemoryTag::ChunkIndex>
+class ChunkGrid
+{
+public:
+	struct Slot {
+		int I = 0;
+		int J = 0;
+		uint32_t Generation = 0;  // 0 => slot has never been claimed
+		bool Ready = false;       // true => Data holds the content for chunk (I, J)
+		T Data = {};
+	};
+
+public:
+	ChunkGrid(const uint32_t radius = 1) {
+		SetRadius(radius);
+	}
+
+	// Resizes the grid so that it can hold a window of chunks of the given radius (around some centre chunk).
+	// All slots are cleared.
+	void SetRadius(const uint32_t radius) {
+		m_Radius = radius;
+		m_Shift = 0;
+		while ((1u << m_Shift) < (2 * radius + 1)) {
+			++m_Shift;
+		}
+		m_Mask = (1u << m_Shift) - 1;
+		m_Slots.clear();
+		m_Slots.resize(static_cast<size_t>(1) << (2 * m_Shift));
+	}
+
+	// Resizes the grid so that it can hold a window of chunks of the given radius, keeping as many of the chunks it
+	// holds as fit, nearest to chunk (centreI, centreJ) first.  (growing the grid keeps them all: chunks that had
+	// different slots still do)  A chunk that is kept moves to its new slot along with its generation, so work
+	// queued against it stays current.  The data of chunks that are not kept is moved to evicted, so that the caller
+	// can free it at its leisure.
+	void Resize(const uint32_t radius, const int centreI, const int centreJ, std::vector<T>& evicted) {
+		std::vector<Slot, TaggedAllocator<Slot, Tag>> slots;
+		std::swap(slots, m_Slots);
+		SetRadius(radius);
+
+		std::vector<Slot*> claimed;
+		for (Slot& slot : slots) {
+			if (slot.Generation != 0) {
+				claimed.push_back(&slot);
+			}
+		}
+		auto distance = [&](const Slot* slot) { return std::max(std::abs(slot->I - centreI), std::abs(slot->J - centreJ)); };
+		std::sort(claimed.begin(), claimed.end(), [&](const Slot* a, const Slot* b) { return distance(a) < distance(b); });
+		for (Slot* slot : claimed) {
+			Slot& target = m_Slots[Index(slot->I, slot->J)];
+			if (target.Generation == 0) {
+				target = std::move(*slot);
+			} else {
+				evicted.push_back(std::move(slot->Data));
+			}
+		}
+	}
+
+	uint32_t GetRadius() const { return m_Radius; }
+
+	// Number of slots along each side of the grid
+	uint32_t GetSize() const { return m_Mask + 1; }
+
+	// Returns the slot that chunk (i, j) maps to.  The slot may currently be holding some other chunk.
+	Slot& GetSlot(const int i, const int j) { return m_Slots[Index(i, j)]; }
+	const Slot& GetSlot(const int i, const int j) const { return m_Slots[Index(i, j)]; }
+
+	// Returns the data for chunk (i, j), or nullptr if chunk (i, j) is not resident (or is not ready yet)
+	T* Find(const int i, const int j) {
+		Slot& slot = m_Slots[Index(i, j)];
+		return ((slot.I == i) & (slot.J == j) & slot.Ready) ? &slot.Data : nullptr;
+	}
+
+	const T* Find(const int i, const int j) const {
+		const Slot& slot = m_Slots[Index(i, j)];
+		return ((slot.I == i) & (slot.J == j) & slot.Ready) ? &slot.Data : nullptr;
+	}
+
+	// Returns true if chunk (i, j) has claimed its slot (regardless of whether its data is ready yet)
+	bool IsClaimed(const int i, const int j) const {
+		const Slot& slot = m_Slots[Index(i, j)];
+		return (slot.I == i) & (slot.J == j) & (slot.Generation != 0);
+	}
+
+	// Claims the slot for chunk (i, j), evicting whichever chunk was there before.
+	// Returns the slot's new generation, or 0 if chunk (i, j) had already claimed the slot.
+	// The previous occupant's data is left in the slot (it is not "ready" any more, so cannot be found), so that it
+	// can be swapped out by whoever publishes the new data.  This keeps the cost of freeing it off the caller.
+	uint32_t Claim(const int i, const int j) {
+		Slot& slot = m_Slots[Index(i, j)];
+		if ((slot.I == i) & (slot.J == j) & (slot.Generation != 0)) {
+			return 0;
+		}
+		slot.I = i;
+		slot.J = j;
+		if (++slot.Generation == 0) {
+			slot.Generation = 1;
+		}
+		slot.Ready = false;
+		return slot.Generation;
+	}
+
+	// Returns true if the slot for chunk (i, j) is still at the given generation (i.e. work queued against that
+	// generation is not stale)
+	bool IsCurrent(const int i, const int j, const uint32_t generation) const {
+		const Slot& slot = m_Slots[Index(i, j)];
+		return (slot.I == i) & (slot.J == j) & (slot.Generation == generation);
+	}
+
+	// Publishes data for chunk (i, j), provided the slot is still at the given generation.
+	// On success, data is swapped with the slot's previous contents (so the caller ends up holding whatever was
+	// evicted, and can free it at its leisure) and true is returned.
+	// On failure (the slot has been recycled since the work was queued), nothing is changed and false is returned.
+	bool Publish(const int i, const int j, const uint32_t generation, T& data) {
+		Slot& slot = m_Slots[Index(i, j)];
+		if (!((slot.I == i) & (slot.J == j) & (slot.Generation == generation))) {
+			return false;
+		}
+		std::swap(slot.Data, data);
+		slot.Ready = true;
+		return true;
+	}
+
+private:
+	size_t Index(const int i, const int j) const {
+		// nb: two's complement means masking also does the right thing for negative coordinates
+		return (static_cast<size_t>(static_cast<uint32_t>(j) & m_Mask) << m_Shift) | (static_cast<uint32_t>(i) & m_Mask);
+	}
+
+private:
+	std::vector<Slot, TaggedAllocator<Slot, Tag>> m_Slots;
+	uint32_t m_Radius = 0;
+	uint32_t m_Shift = 0;
+	uint32_t m_Mask = 0;
+};
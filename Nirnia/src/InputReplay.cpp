@@ -0,0 +1,181 @@
+#include "InputReplay.h"
+
+#include "Simulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace {
+
+	constexpr char Magic[4] = {'N', 'R', 'I', 'N'};
+	constexpr uint32_t Version = 2;
+
+	template<typename T>
+	void Write(std::ofstream& file, const T& value) {
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool Read(std::ifstream& file, T& value) {
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	// LEB128 style variable length integers (7 bits per byte, high bit set on all but the last byte)
+	void WriteVarint(std::ofstream& file, uint64_t value) {
+		while (value >= 0x80) {
+			file.put(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		file.put(static_cast<char>(value));
+	}
+
+	bool ReadVarint(std::ifstream& file, uint64_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			char byte;
+			if (!file.get(byte)) {
+				return false;
+			}
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+}
+
+
+InputRecording::InputRecording(const uint32_t seed, const uint32_t actorCount, const uint32_t chunkSize, const uint32_t animationRadius)
+: m_Seed(seed)
+, m_ActorCount(actorCount)
+, m_ChunkSize(chunkSize)
+, m_AnimationRadius(animationRadius)
+{}
+
+
+void InputRecording::Record(const uint64_t tick, const uint8_t keys) {
+	uint8_t previousKeys = m_Changes.empty() ? 0 : m_Changes.back().Keys;
+	if (keys != previousKeys) {
+		m_Changes.push_back({tick, keys});
+	}
+	m_Length = tick + 1;
+}
+
+
+uint8_t InputRecording::GetKeys(const uint64_t tick) {
+	if (m_Changes.empty() || (tick < m_Changes.front().Tick)) {
+		return 0;
+	}
+	if ((m_Cursor >= m_Changes.size()) || (m_Changes[m_Cursor].Tick > tick)) {
+		m_Cursor = 0;
+	}
+	while ((m_Cursor + 1 < m_Changes.size()) && (m_Changes[m_Cursor + 1].Tick <= tick)) {
+		++m_Cursor;
+	}
+	return m_Changes[m_Cursor].Keys;
+}
+
+
+bool InputRecording::Save(const std::string& path) const {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	file.write(Magic, sizeof(Magic));
+	Write(file, Version);
+	Write(file, m_Seed);
+	Write(file, m_ActorCount);
+	Write(file, m_ChunkSize);
+	Write(file, m_AnimationRadius);
+	Write(file, m_Length);
+	Write(file, static_cast<uint64_t>(m_Changes.size()));
+	uint64_t tick = 0;
+	for (const Change& change : m_Changes) {
+		WriteVarint(file, change.Tick - tick);
+		file.put(static_cast<char>(change.Keys));
+		tick = change.Tick;
+	}
+	return static_cast<bool>(file);
+}
+
+
+bool InputRecording::Load(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	char magic[sizeof(Magic)];
+	uint32_t version;
+	uint64_t numChanges;
+	if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), Magic) || !Read(file, version) || (version != Version)) {
+		return false;
+	}
+	if (!Read(file, m_Seed) || !Read(file, m_ActorCount) || !Read(file, m_ChunkSize) || !Read(file, m_AnimationRadius) || !Read(file, m_Length) || !Read(file, numChanges)) {
+		return false;
+	}
+	m_Changes.clear();
+	m_Cursor = 0;
+	uint64_t tick = 0;
+	for (uint64_t n = 0; n < numChanges; ++n) {
+		uint64_t delta;
+		char keys;
+		if (!ReadVarint(file, delta) || !file.get(keys)) {
+			return false;
+		}
+		tick += delta;
+		m_Changes.push_back({tick, static_cast<uint8_t>(keys)});
+	}
+	return true;
+}
+
+
+ScriptedPath ScriptedPath::Line(const glm::vec2& end) {
+	ScriptedPath path;
+	path.m_Waypoints.push_back(end);
+	return path;
+}
+
+
+ScriptedPath ScriptedPath::Spiral(const float spacing, const float radius) {
+	// Archimedean spiral (r = spacing * angle / 2pi), with waypoints roughly one unit apart
+	constexpr float twoPi = 6.28318531f;
+	ScriptedPath path;
+	float angle = 0.0f;
+	for (float r = 0.0f; r < radius; r = spacing * angle / twoPi) {
+		path.m_Waypoints.push_back({r * std::cos(angle), r * std::sin(angle)});
+		angle += 1.0f / std::max(r, 1.0f);
+	}
+	return path;
+}
+
+
+ScriptedPath ScriptedPath::ZigZag(const glm::vec2& legSize, const uint32_t legs) {
+	ScriptedPath path;
+	for (uint32_t leg = 1; leg <= legs; ++leg) {
+		path.m_Waypoints.push_back({leg * legSize.x, (leg % 2) ? legSize.y : -legSize.y});
+	}
+	return path;
+}
+
+
+uint8_t ScriptedPath::GetKeys(const glm::vec2& position, const float stepDistance) {
+	// Arrive at a waypoint when within a step of it (on both axes), and then move on to the next
+	while (!IsFinished() && (std::abs(m_Waypoints[m_Next].x - position.x) <= stepDistance) && (std::abs(m_Waypoints[m_Next].y - position.y) <= stepDistance)) {
+		++m_Next;
+	}
+	SimulationInput input;
+	if (!IsFinished()) {
+		const glm::vec2 delta = m_Waypoints[m_Next] - position;
+		if (delta.x < -stepDistance) {
+			input.Press(InputKey::Left);
+		} else if (delta.x > stepDistance) {
+			input.Press(InputKey::Right);
+		}
+		if (delta.y > stepDistance) {
+			input.Press(InputKey::Up);
+		} else if (delta.y < -stepDistance) {
+			input.Press(InputKey::Down);
+		}
+	}
+	return input.Keys;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A recording of the simulation's input, tick by tick.
+//
+// Only changes of key state are stored, so a recording of a long run of play is small.  On disk, a recording is a
+// short header followed by one record per change: the number of ticks since the previous change (as a variable
+// length integer), and the new key state (one byte).
+//
+// A recording also remembers the seed, the number of actors, and the animation layout (chunk size, and radius around
+// the player's chunk that actors are animated within) that the simulation was started with, which (together with the
+// input) is all that is needed to reproduce the run.
+class InputRecording
+{
+public:
+	InputRecording() = default;
+	InputRecording(const uint32_t seed, const uint32_t actorCount, const uint32_t chunkSize, const uint32_t animationRadius);
+
+	uint32_t GetSeed() const { return m_Seed; }
+	uint32_t GetActorCount() const { return m_ActorCount; }
+	uint32_t GetChunkSize() const { return m_ChunkSize; }
+	uint32_t GetAnimationRadius() const { return m_AnimationRadius; }
+
+	// Number of ticks recorded
+	uint64_t GetLength() const { return m_Length; }
+
+	// Records the keys pressed for given tick.  Ticks must be recorded in order.
+	void Record(const uint64_t tick, const uint8_t keys);
+
+	// Returns the keys pressed at given tick.
+	// Lookups are fastest when made in tick order (as they are during a replay).
+	uint8_t GetKeys(const uint64_t tick);
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+private:
+	struct Change {
+		uint64_t Tick;
+		uint8_t Keys;
+	};
+
+	uint32_t m_Seed = 0;
+	uint32_t m_ActorCount = 0;
+	uint32_t m_ChunkSize = 1;
+	uint32_t m_AnimationRadius = 1;
+	uint64_t m_Length = 0;
+	std::vector<Change> m_Changes;
+	size_t m_Cursor = 0;                // index of change most recently looked up
+};
+
+
+// Input that steers the player along a path through a sequence of waypoints.
+// The keys to press are worked out from the player's position, so the result is as reproducible as the simulation
+// itself.
+class ScriptedPath
+{
+public:
+	// Straight line from the origin
+	static ScriptedPath Line(const glm::vec2& end);
+
+	// Spiral out from the origin, with given distance between turns
+	static ScriptedPath Spiral(const float spacing, const float radius);
+
+	// Zig-zag from the origin, moving legSize.x to the right on each leg, and alternating between +legSize.y and -legSize.y
+	static ScriptedPath ZigZag(const glm::vec2& legSize, const uint32_t legs);
+
+	// Returns the keys to press this tick, given the player's position, and how far the player moves in a tick
+	uint8_t GetKeys(const glm::vec2& position, const float stepDistance);
+
+	bool IsFinished() const { return m_Next >= m_Waypoints.size(); }
+
+private:
+	std::vector<glm::vec2> m_Waypoints;
+	size_t m_Next = 0;                  // index of waypoint currently being steered towards
+};
@@ -1,6 +1,7 @@
 #include "MainLayer.h"
 
 #include "Hazel/Core/Application.h"
+#include "Hazel/Core/Log.h"
 #include "Hazel/Renderer/RenderCommand.h"
 #include "Hazel/Renderer/Renderer2D.h"
 
@@ -8,33 +9,28 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <imgui.h>
 
-#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
 
-MainLayer::MainLayer()
-: Layer("Map")
-{
-	//
-	// loads of options here
-	m_TerrainSampler.SetFrequency(0.02f);                      // Default 0.1
-	m_TerrainSampler.SetInterp(FastNoise::Quintic);            // Default: Quintic
-	m_TerrainSampler.SetNoiseType(FastNoise::SimplexFractal);  // Default: Simplex
-
-	// Fractal noise only
-	m_TerrainSampler.SetFractalOctaves(4);                     // Default 3
-	m_TerrainSampler.SetFractalLacunarity(2.0);                // Default 2.0
-	m_TerrainSampler.SetFractalGain(0.5);                      // Default 0.5  (otherwise known as "persistence")
-	m_TerrainSampler.SetFractalType(FastNoise::FBM);           // Default: FBM
+#ifdef NIRNIA_TRACK_MEMORY
+namespace {
 
-	// + others for Cellular noise...
-
-	m_GrassSampler.SetSeed(2345);
-	m_GrassSampler.SetNoiseType(FastNoise::SimplexFractal);
-	m_GrassSampler.SetFrequency(0.1f);
+	// Texture memory is allocated by Hazel (and the graphics driver), so is estimated: the sheet's pixels as uploaded
+	// (RGBA8), plus the sub-textures cut from it.
+	size_t GetTextureMemory(const Hazel::Ref<Hazel::Texture2D>& sheet, const size_t subTextures) {
+		return (static_cast<size_t>(sheet->GetWidth()) * sheet->GetHeight() * 4) + (subTextures * sizeof(Hazel::SubTexture2D));
+	}
 
-	m_TreeSampler.SetSeed(5433);
-	m_TreeSampler.SetNoiseType(FastNoise::SimplexFractal);
-	m_TreeSampler.SetFrequency(0.02f);
+}
+#endif
 
+MainLayer::MainLayer()
+: Layer("Map")
+, m_Simulation(12345)
+{
 	// note: defer creation of camera until OnAttach(), so we know the correct window size.
 
 }
@@ -43,19 +39,45 @@ MainLayer::MainLayer()
 void MainLayer::OnAttach() {
 	HZ_PROFILE_FUNCTION();
 
+	// (layers are only kept while live tuning is on, see SetKeepLayers())
+	Hazel::Ref<WorldGenerator> generator = Hazel::CreateRef<WorldGenerator>();
+	if (!generator->Load(m_TerrainPath, m_TerrainError)) {
+		HZ_ERROR("Could not load terrain: {0}", m_TerrainError);
+	}
+	m_WorldGenerator = generator;
+	m_TerrainEdit = generator->GetTerrain();
+	m_TerrainCommitVersion = generator->GetVersion();
+
 	m_StopThreads = false;
 	m_ChunkGenerator = std::thread(&MainLayer::ChunkGenerator, this);
-	m_ChunkEraser = std::thread(&MainLayer::ChunkEraser, this);
+	m_Pathfinder.Start(2);
+	SetParallelQuads(m_ParallelQuads);
 
+	// The minimap is built from whatever time the chunk generator leaves spare
+	m_Minimap.SetGenerator(generator);
+	m_Minimap.Start([this] {
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		return !m_ChunksToGenerate.empty();
+	});
+
+	m_QuadBatch.Init();
 	InitGroundTextures();
 	InitPlayer();
 	InitCamera();
 	InitMap();
+	SetCollision(m_Collision);
 }
 
 
 void MainLayer::OnDetach() {
 	HZ_PROFILE_FUNCTION();
+	SetThreadedSimulation(false);
+	m_Pathfinder.Stop();
+	m_QuadBatch.Stop();
+	m_Minimap.Stop();
+	NIRNIA_TRACK_FREE(MemoryTag::Textures, GetTextureMemory(m_BackgroundSheet, m_GroundTextures.size() + m_TreeTextures.size() + 1));
+	NIRNIA_TRACK_FREE(MemoryTag::Textures, GetTextureMemory(m_PlayerSheet, m_PlayerSprites.size()));
 	if (m_ChunkGenerator.joinable()) {
 		{
 			std::lock_guard lock(m_ChunkMutex);
@@ -65,15 +87,6 @@ void MainLayer::OnDetach() {
 		m_ChunkGeneratorCV.notify_one();
 		m_ChunkGenerator.join();
 	}
-	if (m_ChunkEraser.joinable()) {
-		{
-			std::lock_guard lock(m_ChunkMutex);
-			HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
-			m_StopThreads = true;
-		}
-		m_ChunkEraserCV.notify_one();
-		m_ChunkEraser.join();
-	}
 }
 
 
@@ -185,6 +198,16 @@ void MainLayer::InitGroundTextures() {
 	m_TreeTextures[11] = Hazel::SubTexture2D::CreateFromCoords(m_BackgroundSheet, {5, 3}, {128, 128}, {1, 1}); // small dark green shrub
 
 	m_TreeShadowTexture = Hazel::SubTexture2D::CreateFromCoords(m_BackgroundSheet, {15, 11}, {128, 128}, {1, 1});
+
+	for (const auto& texture : m_GroundTextures) {
+		m_GroundQuadSprites.push_back(m_QuadBatch.AddSprite(texture));
+	}
+	for (const auto& texture : m_TreeTextures) {
+		m_TreeQuadSprites.push_back(m_QuadBatch.AddSprite(texture));
+	}
+	m_TreeShadowQuadSprite = m_QuadBatch.AddSprite(m_TreeShadowTexture);
+
+	NIRNIA_TRACK_ALLOCATION(MemoryTag::Textures, GetTextureMemory(m_BackgroundSheet, m_GroundTextures.size() + m_TreeTextures.size() + 1));
 }
 
 
@@ -229,22 +252,26 @@ void MainLayer::InitPlayer() {
 	m_PlayerSprites[29] = Hazel::SubTexture2D::CreateFromCoords(m_PlayerSheet, {5, 0}, {128, 128}, {1, 1});
 	m_PlayerSprites[30] = Hazel::SubTexture2D::CreateFromCoords(m_PlayerSheet, {6, 0}, {128, 128}, {1, 1});
 	m_PlayerSprites[31] = Hazel::SubTexture2D::CreateFromCoords(m_PlayerSheet, {7, 0}, {128, 128}, {1, 1});
+	for (const auto& sprite : m_PlayerSprites) {
+		m_PlayerQuadSprites.push_back(m_QuadBatch.AddSprite(sprite));
+	}
+	NIRNIA_TRACK_ALLOCATION(MemoryTag::Textures, GetTextureMemory(m_PlayerSheet, m_PlayerSprites.size()));
 
-	m_PlayerAnimations.resize(static_cast<int>(PlayerState::NumStates));
+	InitAnimations();
+	m_PreviousSimulationState = m_Simulation.GetState();
+	m_PlayerPos = m_PreviousSimulationState.PlayerPos;
+}
 
-	m_PlayerAnimations[static_cast<int>(PlayerState::Idle0)] = {8, 8, 8, 8, 8, 8, 8, 8};
-	m_PlayerAnimations[static_cast<int>(PlayerState::Idle1)] = {8, 9, 10, 9, 8, 8, 8, 8};
-	m_PlayerAnimations[static_cast<int>(PlayerState::Idle2)] = {12, 12, 13, 13, 12, 12, 13, 13};
-	m_PlayerAnimations[static_cast<int>(PlayerState::Idle3)] = {12, 14, 15, 11, 12, 12, 13, 13};
-	m_PlayerAnimations[static_cast<int>(PlayerState::WalkLeft)] = {0, 1, 2, 3, 4, 5, 6, 7};
-	m_PlayerAnimations[static_cast<int>(PlayerState::WalkRight)] = {0, 1, 2, 3, 4, 5, 6, 7};
-	m_PlayerAnimations[static_cast<int>(PlayerState::WalkUp)] = {24, 25, 26, 27, 28, 29, 30, 31};
-	m_PlayerAnimations[static_cast<int>(PlayerState::WalkDown)] = {16, 17, 18, 19, 20, 21, 22, 23};
 
-	m_PlayerPos = {0, 0};
-	m_PlayerSize = {1, 1};
-	m_PlayerState = PlayerState::Idle0;
-	m_PlayerFrame = 0;
+void MainLayer::InitAnimations() {
+	m_Simulation.SetAnimation(PlayerState::Idle0, {8, 8, 8, 8, 8, 8, 8, 8});
+	m_Simulation.SetAnimation(PlayerState::Idle1, {8, 9, 10, 9, 8, 8, 8, 8});
+	m_Simulation.SetAnimation(PlayerState::Idle2, {12, 12, 13, 13, 12, 12, 13, 13});
+	m_Simulation.SetAnimation(PlayerState::Idle3, {12, 14, 15, 11, 12, 12, 13, 13});
+	m_Simulation.SetAnimation(PlayerState::WalkLeft, {0, 1, 2, 3, 4, 5, 6, 7});
+	m_Simulation.SetAnimation(PlayerState::WalkRight, {0, 1, 2, 3, 4, 5, 6, 7});
+	m_Simulation.SetAnimation(PlayerState::WalkUp, {24, 25, 26, 27, 28, 29, 30, 31});
+	m_Simulation.SetAnimation(PlayerState::WalkDown, {16, 17, 18, 19, 20, 21, 22, 23});
 }
 
 
@@ -252,6 +279,12 @@ void MainLayer::InitCamera() {
 	HZ_PROFILE_FUNCTION();
 	m_AspectRatio = static_cast<float>(Hazel::Application::Get().GetWindow().GetWidth()) / static_cast<float>(Hazel::Application::Get().GetWindow().GetHeight());
 	m_Camera = Hazel::CreateScope<Hazel::OrthographicCamera>(-m_AspectRatio * m_Zoom, m_AspectRatio * m_Zoom, -m_Zoom, m_Zoom);
+	UpdateViewport();
+}
+
+
+void MainLayer::UpdateViewport() {
+	m_Camera->SetProjection(-m_AspectRatio * m_Zoom, m_AspectRatio * m_Zoom, -m_Zoom, m_Zoom);
 
 	auto left = static_cast<int>(std::floor((-m_AspectRatio * m_Zoom) + m_PlayerPos.x - 1.0f));
 	auto right = static_cast<int>(std::ceil(m_AspectRatio * m_Zoom + m_PlayerPos.x + 1.0f));
@@ -263,242 +296,291 @@ void MainLayer::InitCamera() {
 }
 
 
+uint32_t MainLayer::GetStreamingRadius() const {
+	// The view reaches this far from the player, who may be anywhere in their chunk
+	const float reach = (std::max(m_ViewportWidth, m_ViewportHeight) / 2.0f) + 1.0f;
+	return std::max(m_ChunkRadius, static_cast<uint32_t>(std::ceil(reach / m_ChunkSize)));
+}
+
+
 void MainLayer::InitMap() {
-	using namespace std::chrono_literals;
 	HZ_PROFILE_FUNCTION();
 
-	m_ChunkWidth = 2 * m_ViewportWidth;
-	m_ChunkHeight = 2 * m_ViewportHeight;
+	// Chunk (i, j) is tiles [i * size, (i + 1) * size) x [j * size, (j + 1) * size).  Chunks do not overlap, and do not
+	// depend on the size of the window, and navigation chunks are the same as map chunks.
+	// The pathfinder caches a larger area than is kept resident for rendering.
+	NavLayout layout;
+	layout.Width = static_cast<int>(m_ChunkSize);
+	layout.Height = static_cast<int>(m_ChunkSize);
+	const uint32_t radius = GetStreamingRadius();
+	{
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		m_Chunks.SetRadius(radius);
+	}
+	m_Pathfinder.SetLayout(layout, 4 * radius);
+
+	// A recording or scripted run keeps the layout it started with (see ResetSimulation())
+	if (m_InputMode == InputMode::Live) {
+		m_Simulation.SetChunkLayout({static_cast<float>(m_ChunkSize), static_cast<float>(m_ChunkSize)}, m_AnimationRadius);
+	}
 
-	auto chunkX = static_cast<int>(std::round(m_PlayerPos.x / (m_ChunkWidth - m_ViewportWidth)));
-	auto chunkY = static_cast<int>(std::round(m_PlayerPos.y / (m_ChunkHeight - m_ViewportHeight)));
+	// submit the chunks around the player for generation
+	const glm::ivec2 playerTile = GetTile(m_PlayerPos);
+	const int chunkX = layout.GetChunkI(playerTile.x);
+	const int chunkY = layout.GetChunkJ(playerTile.y);
+	StreamMapChunks(chunkX, chunkY);
+	m_PrevChunk = {chunkX, chunkY};
 
-	// submit 9 chunks for generation
-	for (auto j = chunkY - 1; j <= chunkY + 1; ++j) {
-		for (auto i = chunkX - 1; i <= chunkX + 1; ++i) {
-			GenerateMapChunk(i, j);
-		}
+	WaitForChunks();
+}
+
+
+void MainLayer::SetChunkLayout(const uint32_t chunkSize, const uint32_t radius) {
+	HZ_PROFILE_FUNCTION();
+
+	if (chunkSize == m_ChunkSize) {
+		m_ChunkRadius = radius;
+		ResizeChunkWindow(GetStreamingRadius());
+		return;
 	}
 
-	// wait until the chunks are generated
-	bool done = false;
-	while (!done) {
-		std::this_thread::sleep_for(25ms);
+	// The generator reads the chunk size as it goes, so it must be idle before the size changes.  Let it finish the
+	// chunk it is working on (which is at the front of the queue), and drop the rest.
+	{
 		std::lock_guard lock(m_ChunkMutex);
 		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
-		done = m_ChunksToGenerate.empty();
+		if (!m_ChunksToGenerate.empty()) {
+			for (auto request = m_ChunksToGenerate.begin() + 1; request != m_ChunksToGenerate.end(); ++request) {
+				if (request->Regenerate) {
+					--m_RegenerationsPending;
+				} else {
+					++m_ChunkStats.Dropped;
+				}
+			}
+			m_ChunksToGenerate.erase(m_ChunksToGenerate.begin() + 1, m_ChunksToGenerate.end());
+		}
 	}
+	WaitForChunks();
+
+	// Simulation can only be modified while it is not being stepped
+	bool threaded = m_ThreadedSimulation;
+	SetThreadedSimulation(false);
+	m_ChunkSize = chunkSize;
+	m_ChunkRadius = radius;
+	InitMap();
+	SetThreadedSimulation(threaded);
 }
 
 
-void MainLayer::GenerateMapChunk(const int i, const int j) {
+void MainLayer::ResizeChunkWindow(const uint32_t radius) {
+	HZ_PROFILE_FUNCTION();
+
+	if (radius == m_Chunks.GetRadius()) {
+		return;
+	}
+
+	// Queued requests for chunks that are kept stay current (their slots move, generation and all).  Those for
+	// chunks that are dropped go stale, and the generator skips them.
+	auto [i, j] = m_PrevChunk;
+	std::vector<Hazel::Ref<Chunk>> evicted;  // (freed outside of the lock)
 	{
 		std::lock_guard lock(m_ChunkMutex);
 		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
-		m_ChunksToGenerate.emplace(i, j);
+		m_Chunks.Resize(radius, i, j, evicted);
 	}
-	m_ChunkGeneratorCV.notify_one();
+	evicted.clear();
+	m_Pathfinder.SetCacheRadius(4 * radius, i, j);
+	StreamMapChunks(i, j);
 }
 
 
-void MainLayer::ChunkGenerator() {
-	for (;;) {
-		bool isWorkToDo = false;
-		std::pair<int, int> chunk;
-		{
-			// suspend thread until we're told to stop, or there is a chunk to generate
-			std::unique_lock lock(m_ChunkMutex);
-			m_ChunkGeneratorCV.wait(lock, [&] { return m_StopThreads || !m_ChunksToGenerate.empty(); });
-			HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
-			//
-			// Here, we have lock on m_ChunkMutex. This blocks anyone from modifying thread shared data (such as m_StopThread, and the queue)
-			// until we've finished with it.
-			if (m_StopThreads) {
-				break;
-			}
+void MainLayer::WaitForChunks() {
+	using namespace std::chrono_literals;
+	bool done = false;
+	while (!done) {
+		std::this_thread::sleep_for(25ms);
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		done = m_ChunksToGenerate.empty();
+	}
+}
 
-			isWorkToDo = !m_ChunksToGenerate.empty();
-			if (isWorkToDo) {
-				chunk = *m_ChunksToGenerate.begin();
-			}
-		} // release lock
 
-		while (isWorkToDo) {
-			HZ_PROFILE_SCOPE("Generate Map Chunk");
+void MainLayer::StreamMapChunks(const int i, const int j) {
+	HZ_PROFILE_FUNCTION();
 
-			int left = chunk.first * (m_ChunkWidth - m_ViewportWidth) - (m_ChunkWidth / 2);
-			int right = left + m_ChunkWidth;
-			int bottom = chunk.second * (m_ChunkHeight - m_ViewportHeight) - (m_ChunkHeight / 2);
-			int top = bottom + m_ChunkHeight;
-
-			std::vector<uint8_t> groundCorners;
-			std::vector<uint8_t> groundType;
-			std::vector<uint8_t> treeType;
-			std::vector<glm::vec3> treeCoords;
-			std::vector<glm::vec2> treeScale;
-			std::vector<glm::vec3> treeShadowCoords;
-			std::vector<glm::vec2> treeShadowSize;
-			groundCorners.reserve(m_ChunkWidth * m_ChunkHeight);
-			groundType.resize(m_ChunkWidth * m_ChunkHeight);
-			treeType.reserve(m_ChunkWidth * m_ChunkHeight);
-			treeCoords.reserve(m_ChunkWidth * m_ChunkHeight);
-			treeScale.reserve(m_ChunkWidth * m_ChunkHeight);
-			treeShadowCoords.reserve(m_ChunkWidth * m_ChunkHeight);
-			treeShadowSize.reserve(m_ChunkWidth * m_ChunkHeight);
-
-			// TODO: switch to "FasterNoise"  (aka. FastNoiseSIMD)
-
-			// Ground corners
-			for (int y = bottom; y < top; ++y) {
-				for (int x = left; x < right; ++x) {
-					float terrainValue = m_TerrainSampler.GetNoise(static_cast<float>(x), static_cast<float>(y));
-					if (terrainValue < -0.1f) {
-						groundCorners.emplace_back(0);          // water
-					} else if (terrainValue < 0.4f) {
-						groundCorners.emplace_back(1);          // grass
-					} else {
-						groundCorners.emplace_back(2);          // dirt
-					}
+	const int radius = static_cast<int>(m_Chunks.GetRadius());
+	bool isWorkToDo = false;
+	{
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		for (auto y = j - radius; y <= j + radius; ++y) {
+			for (auto x = i - radius; x <= i + radius; ++x) {
+				// Claiming the slot evicts whichever chunk was there before. Nothing is moved or freed here, the
+				// generator swaps the old data out when it publishes the new chunk.
+				if (uint32_t generation = m_Chunks.Claim(x, y)) {
+					m_ChunksToGenerate.push_back({x, y, generation});
+					++m_ChunkStats.Requested;
+					isWorkToDo = true;
 				}
 			}
+		}
+		m_ChunkStats.MaxQueueLength = std::max(m_ChunkStats.MaxQueueLength, m_ChunksToGenerate.size());
+	}
+	if (isWorkToDo) {
+		m_ChunkGeneratorCV.notify_one();
+	}
+}
 
-			// Ground tiles
-			for (int y = bottom + 1; y < top; ++y) {
-				for (int x = left + 1; x < right; ++x) {
-					uint32_t index = ((y - bottom) * m_ChunkWidth) + (x - left);
-					uint8_t groundTile = (27 * groundCorners[index - 1]) + (9 * groundCorners[index]) + (3 * groundCorners[index - m_ChunkWidth - 1]) + groundCorners[index - m_ChunkWidth];
-					if (groundTile == 40) {
-						float grassValue = m_GrassSampler.GetNoise(static_cast<float>(x), static_cast<float>(y));
-						if (grassValue < -0.2f) {
-							groundTile = 40;
-						} else if (grassValue < 0.2f) {
-							groundTile = 81;
-						} else {
-							groundTile = 82;
-						}
-					}
-					groundType[index] = groundTile;
-				}
-			}
 
-			// Trees
-			// The result is underwhelming.  Some sort of poisson disk sampling, with noise-dependent radius might be better
-			// (with pre-generated level of fixed size)
-			for (int y = bottom + 1; y < top; ++y) {
-				for (int x = left + 1; x < right; ++x) {
-					uint32_t index = ((y - bottom) * m_ChunkWidth) + (x - left);
-					uint8_t groundTile = groundType[index];
-
-					// trees don't grow on water tiles (any tile <= 39)
-					if ((groundTile == 40) || (groundTile == 81) || (groundTile == 82))  {
-						float treeValue = m_TreeSampler.GetNoise(static_cast<float>(x), static_cast<float>(y));
-						Random treeRandomizer({x, y});
-						if (treeValue > 0.45f) {
-							// big tree
-							if (treeRandomizer.Uniform0_1() < 0.3f) {
-								float xOffset = treeRandomizer.Uniform(0.2f, 0.8f);
-								float yOffset = treeRandomizer.Uniform(0.2f, 0.8f);
-								float scale = treeRandomizer.Uniform(0.8f, 1.2f);
-								treeType.emplace_back(0);
-								treeCoords.emplace_back(x - xOffset, y - yOffset + scale, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.8f);
-								treeScale.emplace_back(scale, 2.0f * scale);
-								treeShadowCoords.emplace_back(x - xOffset, y - yOffset + 0.36f * scale, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.9f);
-								treeShadowSize.emplace_back(1.2f * scale, 1.2f * scale);
-							}
-						} else if (treeValue > 0.0f) {
-							// small tree
-							if (treeRandomizer.Uniform0_1() < 0.2f) {
-								float xOffset = treeRandomizer.Uniform(0.2f, 0.8f);
-								float yOffset = treeRandomizer.Uniform(0.2f, 0.8f);
-								float scale = treeRandomizer.Uniform(0.8f, 1.2f);
-								treeType.emplace_back(1);
-								treeCoords.emplace_back(x - xOffset, y - yOffset + scale, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.8f);
-								treeScale.emplace_back(scale, 2.0f * scale);
-								treeShadowCoords.emplace_back(x - xOffset, y - yOffset + 0.3f * scale, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.9f);
-								treeShadowSize.emplace_back(scale, scale);
-							}
-						}
-					} else if (groundTile > 40) {
-						float treeValue = m_TreeSampler.GetNoise(static_cast<float>(x), static_cast<float>(y));
-						Random treeRandomizer({x, y});
-						if (treeValue > 0.7f) {
-							// small orange shrub
-							if (treeRandomizer.Uniform0_1() < 0.6f) {
-								float xOffset = treeRandomizer.Uniform0_1();
-								float yOffset = treeRandomizer.Uniform0_1();
-								float scale = 1.0f;
-								treeType.emplace_back(9);
-								treeCoords.emplace_back(x - xOffset, y - yOffset, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.8f);
-								treeScale.emplace_back(scale, scale);
-								treeShadowCoords.emplace_back(x - xOffset, y - yOffset, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.9f);
-								treeShadowSize.emplace_back(scale, scale);
-							}
-						} else if (treeValue > 0.0f) {
-							// orange shrubs
-							if (treeRandomizer.Uniform0_1() < 0.5f) {
-								float xOffset = treeRandomizer.Uniform0_1();
-								float yOffset = treeRandomizer.Uniform0_1();
-								float scale = treeRandomizer.Uniform(0.8f, 1.2f);
-								treeType.emplace_back(8);
-								treeCoords.emplace_back(x - xOffset, y - yOffset, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.8f);
-								treeScale.emplace_back(scale, scale);
-								treeShadowCoords.emplace_back(x - xOffset, y - yOffset - 0.1f * scale, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.9f);
-								treeShadowSize.emplace_back(scale, scale);
-								if (treeRandomizer.Uniform0_1() < 0.5f) {
-									float xOffset = treeRandomizer.Uniform0_1();
-									float yOffset = treeRandomizer.Uniform0_1();
-									float scale = treeRandomizer.Uniform(0.8f, 1.2f);
-									treeType.emplace_back(9);
-									treeCoords.emplace_back(x - xOffset, y - yOffset, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.8f);
-									treeScale.emplace_back(scale, scale);
-									treeShadowCoords.emplace_back(x - xOffset, y - yOffset - 0.21f * scale, ((top - (y - yOffset)) / m_ChunkHeight / 10.0f) - 0.9f);
-									treeShadowSize.emplace_back(0.7f * scale, 0.7f * scale);
-								}
-							}
-						}
-					}
-				}
-			}
+bool MainLayer::SetTerrain(const TerrainGraph& terrain) {
+	HZ_PROFILE_FUNCTION();
 
-			{
-				std::lock_guard lock(m_ChunkMutex);
-				HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
-				m_GroundType.insert(std::make_pair(chunk, std::move(groundType)));
-				m_TreeType.insert(std::make_pair(chunk, std::move(treeType)));
-				m_TreeCoords.insert(std::make_pair(chunk, std::move(treeCoords)));
-				m_TreeScale.insert(std::make_pair(chunk, std::move(treeScale)));
-				m_TreeShadowCoords.insert(std::make_pair(chunk, std::move(treeShadowCoords)));
-				m_TreeShadowSize.insert(std::make_pair(chunk, std::move(treeShadowSize)));
-				m_ChunksToGenerate.erase(m_ChunksToGenerate.begin());
-				isWorkToDo = !m_ChunksToGenerate.empty();
-				if (isWorkToDo) {
-					chunk = *m_ChunksToGenerate.begin();
+	// The generator thread may be part way through a chunk with the current generator, so the change is made to a
+	// copy.  The generator picks up the new one with its next request.
+	Hazel::Ref<WorldGenerator> generator = Hazel::CreateRef<WorldGenerator>(*m_WorldGenerator);
+	if (!generator->SetTerrain(terrain, m_TerrainError)) {
+		return false;
+	}
+	m_TerrainError.clear();
+	m_TerrainChangeFrom = m_WorldGenerator->GetVersion();
+
+	const int radius = static_cast<int>(m_Chunks.GetRadius());
+	auto [i, j] = m_PrevChunk;
+	{
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		m_WorldGenerator = generator;
+		m_TerrainChangeTime = std::chrono::steady_clock::now();
+
+		// Regeneration goes ahead of any chunks still waiting to be streamed in, but behind the chunk that the
+		// generator is working on (which stays at the front of the queue until it is published).
+		// A chunk whose regeneration is already waiting needs nothing more, that will use the new generator.
+		auto position = m_ChunksToGenerate.begin() + (m_ChunksToGenerate.empty() ? 0 : 1);
+		for (auto y = j - radius; y <= j + radius; ++y) {
+			for (auto x = i - radius; x <= i + radius; ++x) {
+				if (!m_Chunks.IsClaimed(x, y)) {
+					continue;
+				}
+				ChunkRequest request = {x, y, m_Chunks.GetSlot(x, y).Generation, true};
+				bool isQueued = std::any_of(position, m_ChunksToGenerate.end(), [&](const ChunkRequest& queued) {
+					return queued.Regenerate && (queued.I == x) && (queued.J == y) && (queued.Generation == request.Generation);
+				});
+				if (!isQueued) {
+					position = m_ChunksToGenerate.insert(position, request) + 1;
+					++m_RegenerationsPending;
 				}
 			}
-
 		}
 	}
+	m_ChunkGeneratorCV.notify_one();
+	return true;
 }
 
 
-void MainLayer::EraseMapChunk(const int i, const int j) {
+void MainLayer::CommitTerrain() {
+	HZ_PROFILE_FUNCTION();
+
+	Hazel::Ref<const WorldGenerator> generator;
 	{
 		std::lock_guard lock(m_ChunkMutex);
 		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
-		m_ChunksToErase.emplace(i, j);
+		generator = m_WorldGenerator;
+	}
+	if (generator->GetVersion() == m_TerrainCommitVersion) {
+		return;
+	}
+
+	// Navigation data cached for chunks that are not resident any more would be out of date
+	if (generator->IsGroundStale(m_TerrainCommitVersion) || generator->AreTreesStale(m_TerrainCommitVersion)) {
+		m_Pathfinder.SetLayout(m_Pathfinder.GetLayout(), 4 * m_Chunks.GetRadius());
+	}
+
+	m_Minimap.SetGenerator(generator);
+	m_TerrainCommitVersion = generator->GetVersion();
+}
+
+
+void MainLayer::SetKeepLayers(const bool keepLayers) {
+	HZ_PROFILE_FUNCTION();
+
+	std::vector<Hazel::Ref<Chunk>> released;  // (freed outside of the lock)
+	std::lock_guard lock(m_ChunkMutex);
+	HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+	if (m_WorldGenerator->IsKeepingLayers() == keepLayers) {
+		return;
+	}
+
+	// As with a change of terrain, the generator thread may be using the current generator, so the change is made to
+	// a copy.  (the minimap keeps the one it has, it only samples)
+	Hazel::Ref<WorldGenerator> generator = Hazel::CreateRef<WorldGenerator>(*m_WorldGenerator);
+	generator->SetKeepLayers(keepLayers);
+	m_WorldGenerator = generator;
+	if (keepLayers) {
+		return;
+	}
+
+	// Resident chunks give up their layers straight away.  Chunks are immutable once published, so each is replaced
+	// by a copy without them.
+	const int radius = static_cast<int>(m_Chunks.GetRadius());
+	auto [i, j] = m_PrevChunk;
+	for (auto y = j - radius; y <= j + radius; ++y) {
+		for (auto x = i - radius; x <= i + radius; ++x) {
+			Hazel::Ref<Chunk>* resident = m_Chunks.Find(x, y);
+			if (!resident || !*resident || (*resident)->Layers.empty()) {
+				continue;
+			}
+			Hazel::Ref<Chunk> stripped = Hazel::CreateRef<Chunk>();
+			stripped->GroundType = (*resident)->GroundType;
+			stripped->Trees = (*resident)->Trees;
+			released.push_back(std::move(*resident));
+			*resident = std::move(stripped);
+		}
 	}
-	m_ChunkEraserCV.notify_one();
 }
 
 
-void MainLayer::ChunkEraser() {
+void MainLayer::ChunkGenerator() {
+	Hazel::Ref<const WorldGenerator> generator;
+	Hazel::Ref<Chunk> previous;
+
+	// Must be called with m_ChunkMutex held, when a regeneration request is done with (whether it was carried out or dropped)
+	auto regenerated = [this]() {
+		if (--m_RegenerationsPending == 0) {
+			m_RegenerationLatency = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_TerrainChangeTime).count();
+		}
+	};
+
+	// Pops requests off the front of the queue until a non-stale one is found, and picks up what's needed to carry
+	// it out (the current generator, and the chunk's current content if it is being regenerated).
+	// Must be called with m_ChunkMutex held.
+	auto nextRequest = [&](ChunkRequest& chunk) {
+		while (!m_ChunksToGenerate.empty()) {
+			chunk = m_ChunksToGenerate.front();
+			if (m_Chunks.IsCurrent(chunk.I, chunk.J, chunk.Generation)) {
+				generator = m_WorldGenerator;
+				const Hazel::Ref<Chunk>* resident = chunk.Regenerate ? m_Chunks.Find(chunk.I, chunk.J) : nullptr;
+				previous = resident ? *resident : nullptr;
+				return true;
+			}
+			m_ChunksToGenerate.pop_front();
+			if (chunk.Regenerate) {
+				regenerated();
+			} else {
+				++m_ChunkStats.Dropped;
+			}
+		}
+		return false;
+	};
+
 	for (;;) {
 		bool isWorkToDo = false;
-		std::pair<int, int> chunk;
+		ChunkRequest chunk;
 		{
 			// suspend thread until we're told to stop, or there is a chunk to generate
 			std::unique_lock lock(m_ChunkMutex);
-			m_ChunkEraserCV.wait(lock, [&] { return m_StopThreads || !m_ChunksToErase.empty(); });
+			m_ChunkGeneratorCV.wait(lock, [&] { return m_StopThreads || !m_ChunksToGenerate.empty(); });
 			HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
 			//
 			// Here, we have lock on m_ChunkMutex. This blocks anyone from modifying thread shared data (such as m_StopThread, and the queue)
@@ -507,29 +589,76 @@ void MainLayer::ChunkEraser() {
 				break;
 			}
 
-			isWorkToDo = !m_ChunksToErase.empty();
-			if (isWorkToDo) {
-				chunk = *m_ChunksToErase.begin();
-			}
+			isWorkToDo = nextRequest(chunk);
 		} // release lock
 
 		while (isWorkToDo) {
-			HZ_PROFILE_SCOPE("Erase Map Chunk");
+			HZ_PROFILE_SCOPE("Generate Map Chunk");
+			auto generationStart = std::chrono::steady_clock::now();
+
+			// Each tile's ground type depends on its corners, so chunks are generated with an extra row and column
+			// below and to the left (which the generator leaves empty, and which are not drawn)
+			const int size = static_cast<int>(m_ChunkSize) + 1;
+			int left = chunk.I * static_cast<int>(m_ChunkSize) - 1;
+			int bottom = chunk.J * static_cast<int>(m_ChunkSize) - 1;
+
+			Hazel::Ref<Chunk> data = Hazel::CreateRef<Chunk>();
+			generator->Generate(left, bottom, size, size, *data, previous.get());
+			previous.reset();
+			const ChunkGround& groundType = data->GroundType;
+			const ChunkTrees& trees = data->Trees;
+
+			// Walkability.  Water and the tiles that blocking trees stand on are blocked (see IsWalkableGround()).
+			{
+				HZ_PROFILE_SCOPE("Build Chunk Navigation");
+				const NavLayout& navLayout = m_Pathfinder.GetLayout();
+				Hazel::Ref<ChunkNav> nav = Hazel::CreateRef<ChunkNav>();
+				nav->Left = navLayout.GetLeft(chunk.I);
+				nav->Bottom = navLayout.GetBottom(chunk.J);
+				nav->Width = navLayout.Width;
+				nav->Height = navLayout.Height;
+				nav->Version = generator->GetVersion();
+				nav->Walkable.resize(nav->Width * nav->Height);
+				for (int y = 0; y < nav->Height; ++y) {
+					for (int x = 0; x < nav->Width; ++x) {
+						uint32_t index = ((nav->Bottom + y - bottom) * size) + (nav->Left + x - left);
+						nav->Walkable[y * nav->Width + x] = IsWalkableGround(groundType[index]);
+					}
+				}
+				for (const Tree& tree : trees) {
+					glm::ivec2 tile = GetTile({left + tree.GetX(), bottom + tree.GetY()});
+					if (GetTreeKindInfo(tree.Kind).Blocking && nav->Contains(tile)) {
+						nav->Walkable[(tile.y - nav->Bottom) * nav->Width + (tile.x - nav->Left)] = 0;
+					}
+				}
+				nav->Build();
+				m_Pathfinder.AddChunk(chunk.I, chunk.J, nav);
+			}
+
+			float generationTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - generationStart).count();
 			{
 				std::lock_guard lock(m_ChunkMutex);
 				HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
-				m_GroundType.erase(chunk);
-				m_TreeType.erase(chunk);
-				m_TreeCoords.erase(chunk);
-				m_TreeScale.erase(chunk);
-				m_TreeShadowCoords.erase(chunk);
-				m_TreeShadowSize.erase(chunk);
-				m_ChunksToErase.erase(m_ChunksToErase.begin());
-				isWorkToDo = !m_ChunksToErase.empty();
-				if (isWorkToDo) {
-					chunk = *m_ChunksToErase.begin();
+				// If the slot has been recycled while we were generating, then this chunk is no longer wanted and
+				// data is simply dropped.  Otherwise, data ends up holding whatever chunk was evicted from the slot.
+				bool isPublished = m_Chunks.Publish(chunk.I, chunk.J, chunk.Generation, data);
+				if (chunk.Regenerate) {
+					m_ChunkStats.Regenerated += isPublished ? 1 : 0;
+					m_ChunkStats.RegenerationTime += generationTime;
+					regenerated();
+				} else {
+					if (isPublished) {
+						++m_ChunkStats.Generated;
+					} else {
+						++m_ChunkStats.Dropped;
+					}
+					m_ChunkStats.GenerationTime += generationTime;
+					m_ChunkStats.MaxGenerationTime = std::max(m_ChunkStats.MaxGenerationTime, generationTime);
 				}
+				m_ChunksToGenerate.pop_front();
+				isWorkToDo = nextRequest(chunk);
 			}
+			data.reset(); // free evicted chunk (if any) outside of the lock
 		}
 	}
 }
@@ -542,98 +671,202 @@ void MainLayer::OnUpdate(Hazel::Timestep ts) {
 	Hazel::Renderer2D::ResetStats();
 	Hazel::Renderer2D::StatsBeginFrame();
 
-	UpdatePlayer(ts);
-
-	glm::vec3 position = {m_PlayerPos, 0.0f};
-	m_Camera->SetPosition(position);
+	if (m_ReplayFinished) {
+		StopInput();
+	}
+	if ((m_InputMode != InputMode::Live) && (m_InputMode != InputMode::Record)) {
+		m_FrameTimes.push_back(ts.GetMilliseconds());
+	}
 
-	// Animate
+	// Simulate
+	float alpha = 0.0f;
 	{
-		//HZ_PROFILE_SCOPE("Animate");
-		m_AnimationAccumulator += ts;
-		if (m_AnimationAccumulator > 0.1f) {
-			m_AnimationAccumulator = 0.0f;
-			m_PlayerFrame = ++m_PlayerFrame % m_PlayerAnimations[static_cast<int>(m_PlayerState)].size();
-			if (IsIdle(m_PlayerState) && (m_PlayerFrame == 0)) {
-				if (m_Random.Uniform0_1() < 0.25f) {
-					m_PlayerState = SetBlinkState(m_PlayerState);
-				} else {
-					m_PlayerState = ClearBlinkState(m_PlayerState);
-				}
-				if (m_Random.Uniform0_1() < 1.0f / 8.0f) {
-					m_PlayerState = SwapFootTapState(m_PlayerState);
-				}
-			} 
+		SimulationInput input = SampleInput();
+		if (m_ThreadedSimulation) {
+			m_LatestInput = input.Keys;
+			SimulationStateBuffer::Clock::time_point publishTime;
+			m_SimulationBuffer.Read(m_PublishedPreviousState, m_PublishedState, m_PublishedStats, publishTime);
+			alpha = std::chrono::duration<float>(SimulationStateBuffer::Clock::now() - publishTime).count() / Simulation::TickDuration;
+		} else {
+			// Clamp the accumulator so that a long stall (e.g. dragging the window) doesn't result in a burst of
+			// ticks that we then can't keep up with
+			m_SimulationAccumulator = std::min(m_SimulationAccumulator + ts, 0.25f);
+			while (m_SimulationAccumulator >= Simulation::TickDuration) {
+				m_PreviousSimulationState = m_Simulation.GetState();
+				StepSimulation(input.Keys);
+				m_SimulationAccumulator -= Simulation::TickDuration;
+			}
+			alpha = m_SimulationAccumulator / Simulation::TickDuration;
 		}
 	}
+	const SimulationState& previous = m_ThreadedSimulation ? m_PublishedPreviousState : m_PreviousSimulationState;
+	const SimulationState& current = m_ThreadedSimulation ? m_PublishedState : m_Simulation.GetState();
+	m_PlayerPos = glm::mix(previous.PlayerPos, current.PlayerPos, std::clamp(alpha, 0.0f, 1.0f));
+	m_SimulationTick = current.Tick;
+	m_AnimationTime = (m_ThreadedSimulation ? m_PublishedStats : m_Simulation.GetStats()).AnimationTime;
 
-	auto i = static_cast<int>(std::round(m_PlayerPos.x / (m_ChunkWidth - m_ViewportWidth)));
-	auto j = static_cast<int>(std::round(m_PlayerPos.y / (m_ChunkHeight - m_ViewportHeight)));
+	glm::vec3 position = {m_PlayerPos, 0.0f};
+	m_Camera->SetPosition(position);
+
+	const int chunkSize = static_cast<int>(m_ChunkSize);
+	const glm::ivec2 playerTile = GetTile(m_PlayerPos);
+	auto i = NavLayout::FloorDiv(playerTile.x, chunkSize);
+	auto j = NavLayout::FloorDiv(playerTile.y, chunkSize);
 	auto left = static_cast<int>(std::floor((-m_AspectRatio * m_Zoom) + m_PlayerPos.x - 1.0f));
 	auto bottom = static_cast<int>(std::floor(-m_Zoom + m_PlayerPos.y - 2.0f));
-
-	int chunkLeft = i * (m_ChunkWidth - m_ViewportWidth) - m_ViewportWidth;
-	int chunkBottom = j * (m_ChunkHeight - m_ViewportHeight) - m_ViewportHeight;
-	int chunkTop = chunkBottom + m_ChunkHeight;
+	auto right = left + static_cast<int>(m_ViewportWidth);
+	auto top = bottom + static_cast<int>(m_ViewportHeight);
 
 	std::pair chunk = {i, j};
-	if (chunk.first != m_PrevChunk.first) {
-		GenerateMapChunk(chunk.first + (chunk.first - m_PrevChunk.first), chunk.second - 1);
-		GenerateMapChunk(chunk.first + (chunk.first - m_PrevChunk.first), chunk.second);
-		GenerateMapChunk(chunk.first + (chunk.first - m_PrevChunk.first), chunk.second + 1);
-		EraseMapChunk(m_PrevChunk.first - (chunk.first - m_PrevChunk.first), m_PrevChunk.second - 1);
-		EraseMapChunk(m_PrevChunk.first - (chunk.first - m_PrevChunk.first), m_PrevChunk.second);
-		EraseMapChunk(m_PrevChunk.first - (chunk.first - m_PrevChunk.first), m_PrevChunk.second + 1);
-	}
-	if (chunk.second != m_PrevChunk.second) {
-		GenerateMapChunk(chunk.first - 1, chunk.second + (chunk.second - m_PrevChunk.second));
-		GenerateMapChunk(chunk.first, chunk.second + (chunk.second - m_PrevChunk.second));
-		GenerateMapChunk(chunk.first + 1, chunk.second + (chunk.second - m_PrevChunk.second));
-		EraseMapChunk(m_PrevChunk.first - 1, m_PrevChunk.second - (chunk.second - m_PrevChunk.second));
-		EraseMapChunk(m_PrevChunk.first, m_PrevChunk.second - (chunk.second - m_PrevChunk.second));
-		EraseMapChunk(m_PrevChunk.first + 1, m_PrevChunk.second - (chunk.second - m_PrevChunk.second));
+	if (chunk != m_PrevChunk) {
+		StreamMapChunks(chunk.first, chunk.second);
 	}
 	m_PrevChunk = chunk;
 
-	// Render
-	{
-		HZ_PROFILE_SCOPE("Renderer Draw");
-
-		Hazel::RenderCommand::SetClearColor({0.1f, 0.1f, 0.1f, 1});
-		Hazel::RenderCommand::Clear();
+	// Pathfinding benchmark results
+	if (m_PathQueriesPending > 0) {
+		m_PathResults.clear();
+		m_Pathfinder.PollResults(m_PathResults);
+		for (const PathResult& result : m_PathResults) {
+			m_PathBenchmarkFound += result.Found;
+		}
+		m_PathQueriesPending -= std::min<uint64_t>(m_PathQueriesPending, m_PathResults.size());
+		if (m_PathQueriesPending == 0) {
+			m_PathBenchmarkTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_PathBenchmarkStart).count();
+		}
+	}
 
-		Hazel::Renderer2D::BeginScene(*m_Camera);
+	// The chunks covering the view (tiles (left, right) x (bottom, top)), which are stitched together.
+	// Chunk data starts one tile below and to the left of the chunk (see ChunkGenerator()).
+	const int firstI = NavLayout::FloorDiv(left + 1, chunkSize);
+	const int firstJ = NavLayout::FloorDiv(bottom + 1, chunkSize);
+	const int columns = NavLayout::FloorDiv(right - 1, chunkSize) - firstI + 1;
+	const int rows = NavLayout::FloorDiv(top - 1, chunkSize) - firstJ + 1;
+	m_VisibleChunks.assign(columns * rows, nullptr);
+	{
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		for (int row = 0; row < rows; ++row) {
+			for (int column = 0; column < columns; ++column) {
+				if (const Hazel::Ref<Chunk>* data = m_Chunks.Find(firstI + column, firstJ + row)) {
+					m_VisibleChunks[row * columns + column] = *data;
+				}
+			}
+		}
+	}
 
+	// Things further up the screen are drawn behind those further down.  Depth runs over the whole of the visible
+	// chunks, so that it is consistent from one chunk to the next.
+	const float depthTop = static_cast<float>((firstJ + rows) * chunkSize);
+	const float depthRange = static_cast<float>((rows * chunkSize) + 1);
 
-		// Ground
-		const std::vector<uint8_t>& groundType = m_GroundType[chunk];
-		for (int y = bottom + 1; y < bottom + static_cast<int>(m_ViewportHeight); ++y) {
-			for (int x = left + 1; x < left + static_cast<int>(m_ViewportWidth); ++x) {
-				uint32_t index = ((y - chunkBottom) * m_ChunkWidth) + (x - chunkLeft);
-				Hazel::Renderer2D::DrawQuad({x - 0.5f, y - 0.5f, -0.99f}, {1, 1}, m_GroundTextures[groundType[index]]);
-			}
+	// Build quads.  Each range writes its own part of the batch (possibly on a worker thread), and the ranges are
+	// submitted in the order they are added here, so draw order is fixed.
+	{
+		HZ_PROFILE_SCOPE("Build Quads");
+		auto buildStart = std::chrono::steady_clock::now();
+
+		m_QuadBatch.Clear();
+
+		// Ground, in strips of rows
+		for (int firstRow = bottom + 1; firstRow < top; firstRow += GroundRowsPerRange) {
+			const int lastRow = std::min(firstRow + GroundRowsPerRange, top);
+			m_QuadBatch.AddRange((lastRow - firstRow) * m_ViewportWidth, [&, firstRow, lastRow](Quad* quads) {
+				uint32_t count = 0;
+				for (int y = firstRow; y < lastRow; ++y) {
+					const int row = NavLayout::FloorDiv(y, chunkSize) - firstJ;
+					for (int column = 0; column < columns; ++column) {
+						const Chunk* chunk = m_VisibleChunks[row * columns + column].get();
+						if (!chunk) {
+							continue;
+						}
+						const int chunkLeft = ((firstI + column) * chunkSize) - 1;
+						const int chunkBottom = ((firstJ + row) * chunkSize) - 1;
+						const int endX = std::min(right, chunkLeft + 1 + chunkSize);
+						for (int x = std::max(left + 1, chunkLeft + 1); x < endX; ++x) {
+							uint32_t index = ((y - chunkBottom) * (chunkSize + 1)) + (x - chunkLeft);
+							quads[count++] = {{x - 0.5f, y - 0.5f, -0.99f}, {1, 1}, &m_GroundQuadSprites[chunk->GroundType[index]]};
+						}
+					}
+				}
+				return count;
+			});
 		}
 
-		// Tree shadows
-		const std::vector<glm::vec3>& treeShadowCoords = m_TreeShadowCoords[chunk];
-		const std::vector<glm::vec2>& treeShadowSize = m_TreeShadowSize[chunk];
-		for (size_t t = 0; t < treeShadowCoords.size(); ++t) {
-			Hazel::Renderer2D::DrawQuad(treeShadowCoords[t], treeShadowSize[t], m_TreeShadowTexture);
+		// Tree shadows (all of them before any of the trees), then trees
+		for (bool shadows : {true, false}) {
+			for (size_t visible = 0; visible < m_VisibleChunks.size(); ++visible) {
+				const Chunk* chunk = m_VisibleChunks[visible].get();
+				if (!chunk) {
+					continue;
+				}
+				const float chunkLeft = static_cast<float>(((firstI + static_cast<int>(visible % columns)) * chunkSize) - 1);
+				const float chunkBottom = static_cast<float>(((firstJ + static_cast<int>(visible / columns)) * chunkSize) - 1);
+				const Tree* trees = chunk->Trees.data();
+				for (size_t first = 0; first < chunk->Trees.size(); first += TreesPerRange) {
+					const size_t last = std::min(first + TreesPerRange, chunk->Trees.size());
+					m_QuadBatch.AddRange(static_cast<uint32_t>(last - first), [&, shadows, trees, chunkLeft, chunkBottom, first, last](Quad* quads) {
+						uint32_t count = 0;
+						for (size_t n = first; n < last; ++n) {
+							const Tree& tree = trees[n];
+							const TreeKindInfo& info = GetTreeKindInfo(tree.Kind);
+							float scale = tree.GetScale();
+							float y = chunkBottom + tree.GetY();
+							if (shadows) {
+								glm::vec3 position = {chunkLeft + tree.GetX(), y + info.ShadowOffsetY * scale, ((depthTop - y) / depthRange / 10.0f) - 0.9f};
+								quads[count++] = {position, {info.ShadowSize * scale, info.ShadowSize * scale}, &m_TreeShadowQuadSprite};
+							} else {
+								glm::vec3 position = {chunkLeft + tree.GetX(), y + info.OffsetY * scale, ((depthTop - y) / depthRange / 10.0f) - 0.8f};
+								quads[count++] = {position, {info.Width * scale, info.Height * scale}, &m_TreeQuadSprites[info.Texture]};
+							}
+						}
+						return count;
+					});
+				}
+			}
 		}
 
-		// Trees
-		const std::vector<glm::vec3>& treeCoords = m_TreeCoords[chunk];
-		const std::vector<glm::vec2>& treeScale = m_TreeScale[chunk];
-		const std::vector<uint8_t>& treeType = m_TreeType[chunk];
-		for(size_t t = 0; t < treeCoords.size(); ++t) {
-			Hazel::Renderer2D::DrawQuad(treeCoords[t], treeScale[t], m_TreeTextures[treeType[t]]);
+		// Actors (culled to the viewport)
+		const std::vector<glm::vec2>& actorPositions = *current.ActorPositions;
+		const std::vector<uint8_t>& actorSprites = *current.ActorSprites;
+		const size_t actorCount = std::min(actorPositions.size(), actorSprites.size());
+		for (size_t first = Simulation::PlayerActor + 1; first < actorCount; first += ActorsPerRange) {
+			const size_t last = std::min(first + ActorsPerRange, actorCount);
+			m_QuadBatch.AddRange(static_cast<uint32_t>(last - first), [&, first, last](Quad* quads) {
+				uint32_t count = 0;
+				for (size_t actor = first; actor < last; ++actor) {
+					const glm::vec2& actorPos = actorPositions[actor];
+					if ((actorPos.x > left) && (actorPos.x < right) && (actorPos.y > bottom) && (actorPos.y < top)) {
+						glm::vec3 position = {actorPos, ((depthTop - actorPos.y + 0.3f) / depthRange / 10.0f) - 0.8f};
+						quads[count++] = {position, {1, 1}, &m_PlayerQuadSprites[actorSprites[actor]]};
+					}
+				}
+				return count;
+			});
 		}
 
 		// Player
-		glm::vec3 playerPos = {m_PlayerPos, ((chunkTop - m_PlayerPos.y + 0.3f) / m_ChunkHeight / 10.0f) - 0.8f};
-		Hazel::Renderer2D::DrawQuad(playerPos, m_PlayerSize, m_PlayerSprites[m_PlayerAnimations[static_cast<int>(m_PlayerState)][m_PlayerFrame]]);
+		m_QuadBatch.AddRange(1, [&](Quad* quads) {
+			glm::vec3 playerPos = {m_PlayerPos, ((depthTop - m_PlayerPos.y + 0.3f) / depthRange / 10.0f) - 0.8f};
+			quads[0] = {playerPos, current.PlayerSize, &m_PlayerQuadSprites[current.PlayerSprite]};
+			return 1u;
+		});
+
+		m_QuadBatch.Build();
+		m_QuadBuildTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+	}
+
+	// Render
+	{
+		HZ_PROFILE_SCOPE("Renderer Draw");
+		auto submitStart = std::chrono::steady_clock::now();
+
+		Hazel::RenderCommand::SetClearColor({0.1f, 0.1f, 0.1f, 1});
+		Hazel::RenderCommand::Clear();
+
+		m_QuadBatch.Submit(*m_Camera);
 
-		Hazel::Renderer2D::EndScene();
+		m_QuadSubmitTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
 	}
 
 	Hazel::Renderer2D::StatsEndFrame();
@@ -647,35 +880,325 @@ void MainLayer::OnUpdate(Hazel::Timestep ts) {
 }
 
 
-void MainLayer::UpdatePlayer(Hazel::Timestep ts) {
+SimulationInput MainLayer::SampleInput() const {
+	SimulationInput input;
+	if (Hazel::Input::IsKeyPressed(HZ_KEY_A)) {
+		input.Press(InputKey::Left);
+	}
+	if (Hazel::Input::IsKeyPressed(HZ_KEY_D)) {
+		input.Press(InputKey::Right);
+	}
+	if (Hazel::Input::IsKeyPressed(HZ_KEY_W)) {
+		input.Press(InputKey::Up);
+	}
+	if (Hazel::Input::IsKeyPressed(HZ_KEY_S)) {
+		input.Press(InputKey::Down);
+	}
+	return input;
+}
+
+
+void MainLayer::SetThreadedSimulation(const bool threaded) {
 	HZ_PROFILE_FUNCTION();
 
-	constexpr float moveSpeed = 1.5f;
+	if (threaded && !m_SimulationThread.joinable()) {
+		// Make sure there is something for the render thread to read before the first tick is published
+		m_SimulationBuffer.Publish(m_Simulation.GetState(), m_Simulation.GetState(), m_Simulation.GetStats());
+		m_StopSimulationThread = false;
+		m_SimulationThread = std::thread(&MainLayer::SimulationThread, this);
+	} else if (!threaded && m_SimulationThread.joinable()) {
+		m_StopSimulationThread = true;
+		m_SimulationThread.join();
+		m_PreviousSimulationState = m_Simulation.GetState();
+		m_SimulationAccumulator = 0.0f;
+	}
+	m_ThreadedSimulation = threaded;
+}
+
 
-	PlayerState newState = PlayerState::Idle0;
-	if (Hazel::Input::IsKeyPressed(HZ_KEY_A)) {
-		m_PlayerPos.x -= ts * moveSpeed;
-		m_PlayerSize = {-1, 1};
-		newState = PlayerState::WalkLeft;
-	} else if (Hazel::Input::IsKeyPressed(HZ_KEY_D)) {
-		m_PlayerPos.x += ts * moveSpeed;
-		m_PlayerSize = {1, 1};
-		newState = PlayerState::WalkRight;
+void MainLayer::SetParallelQuads(const bool parallel) {
+	HZ_PROFILE_FUNCTION();
+
+	// (the calling thread builds quads too, so it doesn't need a worker of its own)
+	m_QuadBatch.Start(parallel ? std::max(std::thread::hardware_concurrency(), 2u) - 1 : 0);
+	m_ParallelQuads = parallel;
+}
+
+
+void MainLayer::SpawnActors(const uint32_t count) {
+	HZ_PROFILE_FUNCTION();
+
+	// Simulation can only be modified while it is not being stepped
+	bool threaded = m_ThreadedSimulation;
+	SetThreadedSimulation(false);
+	m_Simulation.SpawnActors(count, ActorSpawnRadius);
+	m_PreviousSimulationState = m_Simulation.GetState();
+	SetThreadedSimulation(threaded);
+}
+
+
+void MainLayer::SimulationThread() {
+	using Clock = SimulationStateBuffer::Clock;
+	const auto tickDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(Simulation::TickDuration));
+
+	// If we fall behind (e.g. thread wasn't scheduled for a while), then sleep_until() returns immediately and
+	// ticks run back to back until we have caught up.
+	auto nextTick = Clock::now();
+	SimulationState previous;
+	while (!m_StopSimulationThread) {
+		nextTick += tickDuration;
+		std::this_thread::sleep_until(nextTick);
+
+		previous = m_Simulation.GetState();
+		StepSimulation(m_LatestInput);
+		m_SimulationBuffer.Publish(previous, m_Simulation.GetState(), m_Simulation.GetStats());
 	}
+}
 
-	if (Hazel::Input::IsKeyPressed(HZ_KEY_W)) {
-		m_PlayerPos.y += ts * moveSpeed;
-		newState = PlayerState::WalkUp;
-	} else if (Hazel::Input::IsKeyPressed(HZ_KEY_S)) {
-		m_PlayerPos.y -= ts * moveSpeed;
-		newState = PlayerState::WalkDown;
+
+void MainLayer::ResetSimulation(const uint32_t seed, const uint32_t actorCount, const uint32_t chunkSize, const int animationRadius) {
+	HZ_PROFILE_FUNCTION();
+
+	// Simulation can only be modified while it is not being stepped
+	bool threaded = m_ThreadedSimulation;
+	SetThreadedSimulation(false);
+	m_Simulation = Simulation(seed);
+	InitAnimations();
+	m_Simulation.SetChunkLayout({static_cast<float>(chunkSize), static_cast<float>(chunkSize)}, animationRadius);
+	m_Simulation.SpawnActors(actorCount, ActorSpawnRadius);
+	SetCollision(m_Collision);
+	m_PreviousSimulationState = m_Simulation.GetState();
+	m_PlayerPos = m_PreviousSimulationState.PlayerPos;
+	SetThreadedSimulation(threaded);
+}
+
+
+uint8_t MainLayer::GetTickInput(const uint8_t keys) {
+	const SimulationState& state = m_Simulation.GetState();
+	switch (m_InputMode) {
+		case InputMode::Record:
+			m_Recording.Record(state.Tick, keys);
+			return keys;
+
+		case InputMode::Replay:
+			if (state.Tick >= m_Recording.GetLength()) {
+				m_ReplayFinished = true;
+			}
+			return m_Recording.GetKeys(state.Tick);
+
+		case InputMode::Line:
+		case InputMode::Spiral:
+		case InputMode::ZigZag: {
+			uint8_t scriptedKeys = m_ScriptedPath.GetKeys(state.PlayerPos, Simulation::PlayerSpeed * Simulation::TickDuration);
+			if (m_ScriptedPath.IsFinished()) {
+				m_ReplayFinished = true;
+			}
+			return scriptedKeys;
+		}
+
+		default:
+			return keys;
+	}
+}
+
+
+void MainLayer::StepSimulation(const uint8_t keys) {
+	if (m_Collision) {
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		m_CollisionGenerator = m_WorldGenerator;
+	}
+	m_Simulation.Step({GetTickInput(keys)});
+}
+
+
+void MainLayer::SetAnimationRadius(const int radius) {
+	HZ_PROFILE_FUNCTION();
+
+	m_AnimationRadius = radius;
+	if (m_InputMode != InputMode::Live) {
+		return;
+	}
+
+	// Simulation can only be modified while it is not being stepped
+	bool threaded = m_ThreadedSimulation;
+	SetThreadedSimulation(false);
+	m_Simulation.SetChunkLayout({static_cast<float>(m_ChunkSize), static_cast<float>(m_ChunkSize)}, m_AnimationRadius);
+	SetThreadedSimulation(threaded);
+}
+
+
+void MainLayer::StartInput(const InputMode mode) {
+	HZ_PROFILE_FUNCTION();
+
+	if (m_InputMode != InputMode::Live) {
+		StopInput();
+	}
+
+	// Scripted paths are sized to cross a few chunk boundaries
+	const glm::vec2 stride = {static_cast<float>(m_ChunkSize), static_cast<float>(m_ChunkSize)};
+	uint32_t seed = ReplaySeed;
+	uint32_t actorCount = static_cast<uint32_t>(m_ActorCount);
+	uint32_t chunkSize = m_ChunkSize;
+	int animationRadius = m_AnimationRadius;
+	InputRecording recording(seed, actorCount, chunkSize, static_cast<uint32_t>(animationRadius));
+	ScriptedPath script;
+	switch (mode) {
+		case InputMode::Record:
+			break;
+		case InputMode::Replay:
+			if (!recording.Load(m_RecordingPath)) {
+				HZ_WARN("Could not load input recording '{0}'", m_RecordingPath);
+				return;
+			}
+			seed = recording.GetSeed();
+			actorCount = recording.GetActorCount();
+			chunkSize = recording.GetChunkSize();
+			animationRadius = static_cast<int>(recording.GetAnimationRadius());
+			break;
+		case InputMode::Line:
+			script = ScriptedPath::Line({3.0f * stride.x, 0.0f});
+			break;
+		case InputMode::Spiral:
+			script = ScriptedPath::Spiral(stride.x, 2.0f * stride.x);
+			break;
+		case InputMode::ZigZag:
+			script = ScriptedPath::ZigZag(stride, 4);
+			break;
+		default:
+			return;
+	}
+
+	// Simulation thread (if any) reads the input mode, recording, and script, so must be stopped while they change
+	bool threaded = m_ThreadedSimulation;
+	SetThreadedSimulation(false);
+	m_InputMode = mode;
+	m_Recording = std::move(recording);
+	m_ScriptedPath = std::move(script);
+	m_ReplayFinished = false;
+	m_FrameTimes.clear();
+	{
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		m_ChunkStats = {};
+	}
+	ResetSimulation(seed, actorCount, chunkSize, animationRadius);
+	SetThreadedSimulation(threaded);
+}
+
+
+void MainLayer::StopInput() {
+	HZ_PROFILE_FUNCTION();
+
+	// Make sure the simulation thread (if any) is not using the recording or script
+	bool threaded = m_ThreadedSimulation;
+	SetThreadedSimulation(false);
+	const InputMode mode = m_InputMode;
+	m_InputMode = InputMode::Live;
+	m_ReplayFinished = false;
+	m_Simulation.SetChunkLayout({static_cast<float>(m_ChunkSize), static_cast<float>(m_ChunkSize)}, m_AnimationRadius);
+	SetThreadedSimulation(threaded);
+
+	if (mode == InputMode::Record) {
+		if (m_Recording.Save(m_RecordingPath)) {
+			HZ_INFO("Saved input recording '{0}' ({1} ticks)", m_RecordingPath, m_Recording.GetLength());
+		} else {
+			HZ_WARN("Could not save input recording '{0}'", m_RecordingPath);
+		}
+		return;
+	}
+
+	std::vector<float> frameTimes = m_FrameTimes;
+	std::sort(frameTimes.begin(), frameTimes.end());
+	auto percentile = [&frameTimes](const float p) {
+		return frameTimes.empty() ? 0.0f : frameTimes[static_cast<size_t>(p * (frameTimes.size() - 1))];
+	};
+	ChunkStats chunkStats;
+	{
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		chunkStats = m_ChunkStats;
 	}
 
-	if (newState != m_PlayerState) {
-		if (!IsIdle(newState) || !IsIdle(m_PlayerState)) {
-			m_PlayerState = newState;
-			m_PlayerFrame = 0;
+	char buffer[512];
+	sprintf_s(buffer, 512,
+		"Frames: %zu, frame time (ms): p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n"
+		"Chunks: %llu requested, %llu generated, %llu dropped, max queue %zu, generation time (ms): average %.3f, max %.3f",
+		frameTimes.size(), percentile(0.5f), percentile(0.9f), percentile(0.99f), percentile(1.0f),
+		static_cast<unsigned long long>(chunkStats.Requested), static_cast<unsigned long long>(chunkStats.Generated), static_cast<unsigned long long>(chunkStats.Dropped), chunkStats.MaxQueueLength,
+		chunkStats.Generated ? chunkStats.GenerationTime / chunkStats.Generated : 0.0, chunkStats.MaxGenerationTime
+	);
+	m_ReplayReport = buffer;
+	HZ_INFO("Replay finished.\n{0}", m_ReplayReport);
+}
+
+
+void MainLayer::SetCollision(const bool collision) {
+	HZ_PROFILE_FUNCTION();
+
+	// Simulation can only be modified while it is not being stepped
+	bool threaded = m_ThreadedSimulation;
+	SetThreadedSimulation(false);
+	// Walkability is read from the navigation built by the chunk generator, provided that it was built with the
+	// current terrain.  Tiles that have not been generated yet (or not since the terrain changed) are worked out from
+	// the terrain directly.  Both give the same answer, so the player moves the same way however far the chunk
+	// generator has got.  The generator is picked up once per tick (see StepSimulation()).
+	m_CollisionNav.reset();
+	if (collision) {
+		{
+			std::lock_guard lock(m_ChunkMutex);
+			HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+			m_CollisionGenerator = m_WorldGenerator;
 		}
+		m_Simulation.SetCollision([this](const glm::ivec2& tile) {
+			const WorldGenerator& generator = *m_CollisionGenerator;
+			auto isCurrent = [&] { return m_CollisionNav && m_CollisionNav->Contains(tile) && (m_CollisionNav->Version == generator.GetVersion()); };
+			if (!isCurrent()) {
+				m_CollisionNav = m_Pathfinder.GetChunkAt(tile);
+			}
+			return isCurrent() ? m_CollisionNav->IsWalkable(tile) : generator.IsWalkable(tile.x, tile.y);
+		});
+	} else {
+		m_Simulation.SetCollision({});
+	}
+	m_Collision = collision;
+	SetThreadedSimulation(threaded);
+}
+
+
+void MainLayer::BenchmarkPaths(const uint32_t count) {
+	HZ_PROFILE_FUNCTION();
+
+	// Start and goal are chosen from the chunks that are resident around the player (and hence are in the
+	// pathfinder's cache)
+	const NavLayout& layout = m_Pathfinder.GetLayout();
+	const glm::ivec2 playerTile = GetTile(m_PlayerPos);
+	const int i = layout.GetChunkI(playerTile.x);
+	const int j = layout.GetChunkJ(playerTile.y);
+	const int radius = static_cast<int>(m_Chunks.GetRadius());
+	const int left = layout.GetLeft(i - radius);
+	const int right = layout.GetLeft(i + radius + 1) - 1;
+	const int bottom = layout.GetBottom(j - radius);
+	const int top = layout.GetBottom(j + radius + 1) - 1;
+	auto randomTile = [&]() {
+		glm::ivec2 tile;
+		for (int attempt = 0; attempt < 100; ++attempt) {
+			tile = {m_Random.UniformInt(left, right), m_Random.UniformInt(bottom, top)};
+			if (m_Pathfinder.IsWalkable(tile, false)) {
+				break;
+			}
+		}
+		return tile;
+	};
+
+	m_PathResults.clear();
+	m_Pathfinder.PollResults(m_PathResults); // discard results of any previous benchmark
+	m_PathQueriesPending = count;
+	m_PathBenchmarkFound = 0;
+	m_PathBenchmarkTime = 0.0f;
+	m_PathBenchmarkStart = std::chrono::steady_clock::now();
+	for (uint32_t n = 0; n < count; ++n) {
+		m_Pathfinder.Submit({n, randomTile(), randomTile()});
 	}
 }
 
@@ -684,13 +1207,278 @@ void MainLayer::OnImGuiRender() {
 	HZ_PROFILE_FUNCTION();
 
 	ImGui::Begin("Stats");
-	auto stats = Hazel::Renderer2D::GetStats();
-	ImGui::Text("Renderer2D Stats:");
-	ImGui::Text("Draw Calls: %d", stats.DrawCalls);
-	ImGui::Text("Quads: %d", stats.QuadCount);
-	ImGui::Text("Vertices: %d", stats.GetTotalVertexCount());
-	ImGui::Text("Indices: %d", stats.GetTotalIndexCount());
+	const QuadBatch::Stats& stats = m_QuadBatch.GetStats();
+	ImGui::Text("Quad Batch Stats:");
+	ImGui::Text("Draw Calls: %u", stats.DrawCalls);
+	ImGui::Text("Quads: %u", stats.QuadCount);
+	ImGui::Text("Vertices: %u", stats.QuadCount * 4);
+	ImGui::Text("Indices: %u", stats.QuadCount * 6);
+	bool parallelQuads = m_ParallelQuads;
+	if (ImGui::Checkbox("Parallel Quads", &parallelQuads)) {
+		SetParallelQuads(parallelQuads);
+	}
+	ImGui::Text("Build Quads: %.3f ms (%u threads)", m_QuadBuildTime, m_QuadBatch.GetThreadCount() + 1);
+	ImGui::Text("Submit Quads: %.3f ms (%u quads)", m_QuadSubmitTime, m_QuadBatch.GetQuadCount());
+	ImGui::Separator();
+	// (changing the size regenerates the map)
+	static const char* chunkSizes[] = {"16", "32", "64", "128"};
+	int chunkSizeIndex = 0;
+	while ((16u << chunkSizeIndex) < m_ChunkSize) {
+		++chunkSizeIndex;
+	}
+	if (ImGui::Combo("Chunk Size", &chunkSizeIndex, chunkSizes, 4)) {
+		SetChunkLayout(16u << chunkSizeIndex, m_ChunkRadius);
+	}
+	int chunkRadius = static_cast<int>(m_ChunkRadius);
+	if (ImGui::SliderInt("Chunk Radius", &chunkRadius, 1, 8)) {
+		SetChunkLayout(m_ChunkSize, static_cast<uint32_t>(chunkRadius));
+	}
+	const uint32_t residentSide = (2 * m_Chunks.GetRadius()) + 1;
+	ImGui::Text("Resident Chunks: %u x %u, %u tiles square", residentSide, residentSide, m_ChunkSize);
+	ImGui::Separator();
+	ImGui::Text("Simulation Tick: %llu", static_cast<unsigned long long>(m_SimulationTick));
+	bool threadedSimulation = m_ThreadedSimulation;
+	if (ImGui::Checkbox("Threaded Simulation", &threadedSimulation)) {
+		SetThreadedSimulation(threadedSimulation);
+	}
+	ImGui::Text("Animation Update: %.3f ms", m_AnimationTime);
+	// (not the streaming radius: what is animated must not depend on the view, for the simulation to be reproducible)
+	int animationRadius = m_AnimationRadius;
+	if (ImGui::SliderInt("Animation Radius", &animationRadius, 1, 8)) {
+		SetAnimationRadius(animationRadius);
+	}
+	ImGui::SliderInt("Actors", &m_ActorCount, 0, 100000);
+	if (ImGui::Button("Spawn Actors")) {
+		SpawnActors(static_cast<uint32_t>(m_ActorCount));
+	}
+	ImGui::Separator();
+	bool collision = m_Collision;
+	if (ImGui::Checkbox("Collision", &collision)) {
+		SetCollision(collision);
+	}
+	Pathfinder::Stats pathStats = m_Pathfinder.GetStats();
+	ImGui::Text("Path Queries: %llu (%llu found)", static_cast<unsigned long long>(pathStats.Queries), static_cast<unsigned long long>(pathStats.Found));
+	ImGui::Text("Average Query: %.3f ms", pathStats.Queries ? pathStats.TotalTime / pathStats.Queries : 0.0);
+	ImGui::SliderInt("Path Queries", &m_PathQueryCount, 1, 10000);
+	if (ImGui::Button("Benchmark Paths") && (m_PathQueriesPending == 0)) {
+		BenchmarkPaths(static_cast<uint32_t>(m_PathQueryCount));
+	}
+	if (m_PathQueriesPending > 0) {
+		ImGui::Text("Benchmark: %llu queries pending", static_cast<unsigned long long>(m_PathQueriesPending));
+	} else if (m_PathBenchmarkTime > 0.0f) {
+		ImGui::Text("Benchmark: %.0f queries/s (%llu found)", m_PathQueryCount / m_PathBenchmarkTime, static_cast<unsigned long long>(m_PathBenchmarkFound));
+	}
+	ImGui::End();
+
+	ImGui::Begin("Replay");
+	ImGui::InputText("File", m_RecordingPath, sizeof(m_RecordingPath));
+	if (m_InputMode == InputMode::Live) {
+		if (ImGui::Button("Record")) {
+			StartInput(InputMode::Record);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Replay")) {
+			StartInput(InputMode::Replay);
+		}
+		if (ImGui::Button("Line")) {
+			StartInput(InputMode::Line);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Spiral")) {
+			StartInput(InputMode::Spiral);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Zig-Zag")) {
+			StartInput(InputMode::ZigZag);
+		}
+	} else {
+		ImGui::TextUnformatted((m_InputMode == InputMode::Record) ? "Recording..." : "Replaying...");
+		if (ImGui::Button("Stop")) {
+			StopInput();
+		}
+	}
+	ImGui::TextUnformatted(m_ReplayReport.c_str());
 	ImGui::End();
+
+	// Changes take effect as they are made.  With live tuning on, only what they affect is regenerated (see
+	// WorldGenerator), so tuning the trees or the grass does not rebuild the ground.  That needs the chunks' layers,
+	// which cost several times the chunks themselves, so are kept only while live tuning is on (and the first change
+	// after turning it on regenerates in full).
+	ImGui::Begin("Terrain");
+	if (ImGui::Checkbox("Live Tuning", &m_LiveTuning)) {
+		SetKeepLayers(m_LiveTuning);
+	}
+	ImGui::InputText("Terrain File", m_TerrainPath, sizeof(m_TerrainPath));
+	if (ImGui::Button("Load")) {
+		TerrainGraph terrain;
+		if (terrain.Load(m_TerrainPath, m_TerrainError) && SetTerrain(terrain)) {
+			m_TerrainEdit = terrain;
+			m_TerrainEditPending = false;
+			CommitTerrain();
+		}
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Save")) {
+		if (m_TerrainEdit.Save(m_TerrainPath, m_TerrainError)) {
+			HZ_INFO("Terrain written to {0}", m_TerrainPath);
+		}
+	}
+	if (!m_TerrainError.empty()) {
+		ImGui::Text("Error: %s", m_TerrainError.c_str());
+	}
+	{
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		const WorldGenerator& generator = *m_WorldGenerator;
+		ImGui::Text("Last Change: %zu of %zu steps, ground %s, trees %s", generator.GetStaleStepCount(m_TerrainChangeFrom), generator.GetStepCount(),
+			generator.IsGroundStale(m_TerrainChangeFrom) ? "rebuilt" : "kept", generator.AreTreesStale(m_TerrainChangeFrom) ? "rebuilt" : "kept");
+		if (m_RegenerationsPending > 0) {
+			ImGui::Text("Regenerating: %u chunks pending", m_RegenerationsPending);
+		} else {
+			ImGui::Text("Regenerated In: %.1f ms", m_RegenerationLatency);
+		}
+		ImGui::Text("Chunks Regenerated: %llu (average %.3f ms)", static_cast<unsigned long long>(m_ChunkStats.Regenerated),
+			m_ChunkStats.Regenerated ? m_ChunkStats.RegenerationTime / m_ChunkStats.Regenerated : 0.0);
+	}
+	ImGui::Separator();
+
+	bool isTerrainChanged = false;
+	bool isTerrainCommitted = false;
+	auto edit = [&](const bool changed) {
+		isTerrainChanged |= changed;
+		// (a drag is finished when the widget is let go of, typing when the widget loses focus)
+		isTerrainCommitted |= ImGui::IsItemDeactivatedAfterEdit() || (changed && !ImGui::IsItemActive());
+	};
+	for (size_t index = 0; index < m_TerrainEdit.Nodes.size(); ++index) {
+		TerrainNode& node = m_TerrainEdit.Nodes[index];
+		ImGui::PushID(static_cast<int>(index));
+		switch (node.Op) {
+			case TerrainOp::Noise:
+				if (ImGui::TreeNode(node.Name.c_str())) {
+					edit(ImGui::InputInt("Seed", &node.Noise.Seed));
+					edit(ImGui::DragFloat("Frequency", &node.Noise.Frequency, 0.0005f, 0.0001f, 1.0f, "%.4f"));
+					edit(ImGui::SliderInt("Octaves", &node.Noise.Octaves, 1, 8));
+					edit(ImGui::DragFloat("Lacunarity", &node.Noise.Lacunarity, 0.01f, 1.0f, 4.0f));
+					edit(ImGui::DragFloat("Gain", &node.Noise.Gain, 0.01f, 0.0f, 1.0f));
+					ImGui::TreePop();
+				}
+				break;
+
+			case TerrainOp::Constant:
+				edit(ImGui::DragFloat(node.Name.c_str(), &node.Values[0], 0.01f));
+				break;
+
+			case TerrainOp::Remap:
+				edit(ImGui::DragFloat2(node.Name.c_str(), node.Values.data(), 0.01f));
+				break;
+
+			case TerrainOp::Threshold:
+				if (ImGui::TreeNode(node.Name.c_str())) {
+					// (thresholds must stay in ascending order, so each is limited by its neighbours)
+					for (size_t value = 0; value < node.Values.size(); ++value) {
+						const float low = (value > 0) ? node.Values[value - 1] : std::numeric_limits<float>::lowest();
+						const float high = (value + 1 < node.Values.size()) ? node.Values[value + 1] : std::numeric_limits<float>::max();
+						ImGui::PushID(static_cast<int>(value));
+						edit(ImGui::DragFloat("Threshold", &node.Values[value], 0.01f, low, high));
+						ImGui::PopID();
+					}
+					ImGui::TreePop();
+				}
+				break;
+
+			case TerrainOp::Select:
+			case TerrainOp::Tile:
+				break;
+		}
+		ImGui::PopID();
+	}
+	for (size_t index = 0; index < m_TerrainEdit.TreeRules.size(); ++index) {
+		TreeScatterRule& rule = m_TerrainEdit.TreeRules[index];
+		ImGui::PushID(static_cast<int>(m_TerrainEdit.Nodes.size() + index));
+		if (ImGui::TreeNode("Scatter", "Scatter %d", rule.Value)) {
+			edit(ImGui::SliderFloat("Probability", &rule.Probability, 0.0f, 1.0f));
+			edit(ImGui::DragFloatRange2("Offset", &rule.OffsetMin, &rule.OffsetMax, 0.01f, 0.0f, 1.0f));
+			edit(ImGui::DragFloatRange2("Scale", &rule.ScaleMin, &rule.ScaleMax, 0.01f, 0.1f, 3.9f));
+			edit(ImGui::SliderFloat("Cluster Probability", &rule.ClusterProbability, 0.0f, 1.0f));
+			ImGui::TreePop();
+		}
+		ImGui::PopID();
+	}
+
+	// Edits are passed to the generator at most once a frame, and only once it has finished regenerating for the
+	// previous one, so that a drag does not queue up a regeneration of every resident chunk for every step of it.
+	// Everything else that depends on the terrain is brought up to date once the edit is finished.
+	m_TerrainEditPending |= isTerrainChanged;
+	m_TerrainCommitPending |= isTerrainCommitted;
+	if (m_TerrainEditPending) {
+		bool isGeneratorDrained;
+		{
+			std::lock_guard lock(m_ChunkMutex);
+			HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+			isGeneratorDrained = (m_RegenerationsPending == 0);
+		}
+		if (isGeneratorDrained) {
+			SetTerrain(m_TerrainEdit);
+			m_TerrainEditPending = false;
+		}
+	}
+	if (m_TerrainCommitPending && !m_TerrainEditPending) {
+		CommitTerrain();
+		m_TerrainCommitPending = false;
+	}
+	ImGui::End();
+
+	ImGui::Begin("Minimap");
+	Minimap::Stats minimapStats = m_Minimap.GetStats();
+	ImGui::Text("Tiles: %zu cached, %zu waiting, %llu built (%.2f ms each)", minimapStats.CachedTiles, minimapStats.WantedTiles,
+		static_cast<unsigned long long>(minimapStats.TilesBuilt), minimapStats.TilesBuilt ? minimapStats.BuildTime / minimapStats.TilesBuilt : 0.0);
+	m_Minimap.Draw(m_PlayerPos);
+	ImGui::End();
+
+#ifdef NIRNIA_TRACK_MEMORY
+	// Allocation rates are averaged over (roughly) one second samples, so that they are readable
+	m_MemorySampleTime += ImGui::GetIO().DeltaTime;
+	++m_MemorySampleFrames;
+	MemoryTracker::Snapshot memory = MemoryTracker::GetSnapshot();
+	if (m_MemorySampleTime >= 1.0f) {
+		for (int tag = 0; tag < static_cast<int>(MemoryTag::NumTags); ++tag) {
+			m_MemoryByteRates[tag] = (memory.Tags[tag].AllocatedBytes - m_MemorySnapshot.Tags[tag].AllocatedBytes) / m_MemorySampleTime;
+			m_MemoryAllocationRates[tag] = static_cast<float>(memory.Tags[tag].Allocations - m_MemorySnapshot.Tags[tag].Allocations) / m_MemorySampleFrames;
+		}
+		m_MemorySnapshot = memory;
+		m_MemorySampleTime = 0.0f;
+		m_MemorySampleFrames = 0;
+	}
+
+	ImGui::Begin("Memory");
+	ImGui::Columns(5);
+	ImGui::TextUnformatted("Tag"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Live (KB)"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Peak (KB)"); ImGui::NextColumn();
+	ImGui::TextUnformatted("KB/s"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Allocs/frame"); ImGui::NextColumn();
+	ImGui::Separator();
+	for (int tag = 0; tag < static_cast<int>(MemoryTag::NumTags); ++tag) {
+		ImGui::TextUnformatted(MemoryTracker::GetTagName(static_cast<MemoryTag>(tag))); ImGui::NextColumn();
+		ImGui::Text("%.1f", memory.Tags[tag].LiveBytes / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%.1f", memory.Tags[tag].PeakBytes / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%.1f", m_MemoryByteRates[tag] / 1024.0f); ImGui::NextColumn();
+		ImGui::Text("%.1f", m_MemoryAllocationRates[tag]); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::Separator();
+	ImGui::InputText("Snapshot File", m_MemorySnapshotPath, sizeof(m_MemorySnapshotPath));
+	if (ImGui::Button("Save Snapshot")) {
+		std::ofstream file(m_MemorySnapshotPath);
+		file << MemoryTracker::GetSnapshotJson();
+		if (file) {
+			HZ_INFO("Memory snapshot written to {0}", m_MemorySnapshotPath);
+		} else {
+			HZ_WARN("Could not write memory snapshot to {0}", m_MemorySnapshotPath);
+		}
+	}
+	ImGui::End();
+#endif
 }
 
 
@@ -698,11 +1486,30 @@ void MainLayer::OnEvent(Hazel::Event& e) {
 
 	Hazel::EventDispatcher dispatcher(e);
 	dispatcher.Dispatch<Hazel::WindowResizeEvent>(HZ_BIND_EVENT_FN(MainLayer::OnWindowResize));
+	dispatcher.Dispatch<Hazel::MouseScrolledEvent>(HZ_BIND_EVENT_FN(MainLayer::OnMouseScrolled));
 }
 
 
+// Chunks do not depend on the size of the view, so resizing and zooming only need the chunk window to grow if the
+// view no longer fits in it.
 bool MainLayer::OnWindowResize(Hazel::WindowResizeEvent& e) {
+	if ((e.GetWidth() == 0) || (e.GetHeight() == 0)) {
+		return false;   // (minimized)
+	}
 	m_AspectRatio = static_cast<float>(e.GetWidth()) / static_cast<float>(e.GetHeight());
-	m_Camera->SetProjection(-m_AspectRatio * m_Zoom, m_AspectRatio * m_Zoom, -m_Zoom, m_Zoom);
+	UpdateViewport();
+	if (GetStreamingRadius() > m_Chunks.GetRadius()) {
+		ResizeChunkWindow(GetStreamingRadius());
+	}
+	return false;
+}
+
+
+bool MainLayer::OnMouseScrolled(Hazel::MouseScrolledEvent& e) {
+	m_Zoom = std::clamp(m_Zoom * std::pow(0.9f, e.GetYOffset()), MinZoom, MaxZoom);
+	UpdateViewport();
+	if (GetStreamingRadius() > m_Chunks.GetRadius()) {
+		ResizeChunkWindow(GetStreamingRadius());
+	}
 	return false;
 }
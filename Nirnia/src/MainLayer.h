@@ -1,7 +1,16 @@
 #pragma once
 
+#include "Chunk.h"
+#include "ChunkGrid.h"
+#include "InputReplay.h"
+#include "MemoryTracking.h"
+#include "Minimap.h"
+#include "Pathfinder.h"
+#include "QuadBatch.h"
 #include "PlayerState.h"
 #include "Random.h"
+#include "Simulation.h"
+#include "WorldGenerator.h"
 
 #include <Hazel/Core/Layer.h>
 #include <Hazel/Renderer/OrthographicCamera.h>
@@ -11,41 +20,20 @@
 
 // HACK: (see comments in OnWindowResize)
 #include <Hazel/Events/ApplicationEvent.h>
-
-#include "FastNoise.h"
+#include <Hazel/Events/MouseEvent.h>
 
 #include <glm/glm.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
+#include <string>
 #include <thread>
-#include <unordered_map>
 #include <vector>
 
 
-namespace std {
-
-	template<typename T>
-	void
-		hash_combine(size_t& seed, T const& key) {
-		std::hash<T> hasher;
-		seed ^= hasher(key) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-	}
-
-
-	template<typename T1, typename T2>
-	struct hash<pair<T1, T2>> {
-		size_t operator()(pair<T1, T2> const& p) const {
-			size_t seed(0);
-			hash_combine(seed, p.first);
-			hash_combine(seed, p.second);
-			return seed;
-		}
-	};
-
-}
-
-
 class MainLayer : public Hazel::Layer
 {
 public:
@@ -61,33 +49,121 @@ public:
 
 	void OnEvent(Hazel::Event& e) override;
 
+private:
+	// Where the simulation's input comes from
+	enum class InputMode {
+		Live,       // keyboard
+		Record,     // keyboard, recorded to file
+		Replay,     // recording, played back from file
+		Line,       // scripted paths
+		Spiral,
+		ZigZag
+	};
+
 private:
 	void InitGroundTextures();
 	void InitPlayer();
+	void InitAnimations();
 	void InitCamera();
 	void InitMap();
-	
-	// Submits work to the chunk generator and returns immediately
-	void GenerateMapChunk(const int i, const int j);
+
+	// Sets the camera's projection, and the size of the area drawn around the player, from the window's aspect ratio
+	// and the zoom
+	void UpdateViewport();
+
+	// Number of chunks around the player's chunk that must be resident: the configured radius, or enough to cover
+	// the view if that is more
+	uint32_t GetStreamingRadius() const;
+
+	// Switches to chunks of the given size (in tiles), and the given streaming radius.  A change of size regenerates
+	// the map, a change of radius just resizes the chunk window (see ResizeChunkWindow()).
+	void SetChunkLayout(const uint32_t chunkSize, const uint32_t radius);
+
+	// Resizes the window of resident chunks around the player, keeping the chunks (and navigation) already there, and
+	// queues whichever chunks it is missing.  Returns immediately, the new chunks stream in as they are generated.
+	void ResizeChunkWindow(const uint32_t radius);
+
+	// Blocks until the chunk generator has worked through its queue
+	void WaitForChunks();
+
+	// Claims grid slots for every chunk in the window around chunk (i, j), and submits those that are not already
+	// resident to the chunk generator.  Returns immediately.
+	void StreamMapChunks(const int i, const int j);
 
 	// Generates the map chunks (on a worker thread)
 	void ChunkGenerator();
 
-	// Submits work to the chunk eraser and returns immediately
-	void EraseMapChunk(const int i, const int j);
+	// Switches the chunk generator over to a new terrain, and queues every resident chunk to be brought up to date
+	// with it.  Returns false (with m_TerrainError saying why) if the terrain is not valid.
+	bool SetTerrain(const TerrainGraph& terrain);
 
-	// Erases map chunks (on a worker thread)
-	void ChunkEraser();
+	// Brings everything else that depends on the terrain (the pathfinder's cache, and the minimap) up to date with
+	// the chunk generator's.  Done once an edit is finished, rather than for every step of it.
+	void CommitTerrain();
+
+	// Switches the chunk generator between keeping layers in the chunks (for quick regeneration when the terrain is
+	// changed) and not.  Switching off drops the layers from resident chunks.
+	void SetKeepLayers(const bool keepLayers);
 
 	bool OnWindowResize(Hazel::WindowResizeEvent& e);
+	bool OnMouseScrolled(Hazel::MouseScrolledEvent& e);
+
+	// Reads the keyboard (must be called on the thread that owns the window)
+	SimulationInput SampleInput() const;
+
+	// Switches between stepping the simulation on the render thread (as part of OnUpdate()), and stepping it on
+	// its own thread
+	void SetThreadedSimulation(const bool threaded);
+
+	// Switches between building quads on several threads, and building them on the render thread alone
+	void SetParallelQuads(const bool parallel);
+
+	// Replaces all actors (other than the player) with count new ones
+	void SpawnActors(const uint32_t count);
+
+	// Steps the simulation at a fixed rate (on a worker thread)
+	void SimulationThread();
+
+	// Restarts the simulation from scratch, animating actors within animationRadius chunks (of chunkSize tiles) of
+	// the player's
+	void ResetSimulation(const uint32_t seed, const uint32_t actorCount, const uint32_t chunkSize, const int animationRadius);
+
+	// Returns the input for the next simulation tick, given the keys currently pressed.
+	// Called on whichever thread is stepping the simulation.
+	uint8_t GetTickInput(const uint8_t keys);
+
+	// Steps the simulation by one tick, given the keys currently pressed.
+	// Called on whichever thread is stepping the simulation.
+	void StepSimulation(const uint8_t keys);
 
-	void UpdatePlayer(Hazel::Timestep ts);
+	// Changes how many chunks around the player's have their actors animated.  Takes effect straight away with live
+	// input.  A recording or scripted run keeps the radius it was started with.
+	void SetAnimationRadius(const int radius);
+
+	// Switches input mode.  Every mode other than Live restarts the simulation with a fixed seed, so that runs are
+	// reproducible.
+	void StartInput(const InputMode mode);
+
+	// Switches back to live input, saving the recording (Record mode) or reporting frame times and chunk pipeline
+	// statistics (replays)
+	void StopInput();
+
+	// Turns player collision with water and trees on or off
+	void SetCollision(const bool collision);
+
+	// Submits count queries between random walkable tiles around the player to the pathfinder
+	void BenchmarkPaths(const uint32_t count);
 
 private:
-	Random m_Random;
-	FastNoise m_TerrainSampler;
-	FastNoise m_GrassSampler;
-	FastNoise m_TreeSampler;
+	Hazel::Ref<const WorldGenerator> m_WorldGenerator;            // Guarded by m_ChunkMutex.  Never modified once set, changes of terrain swap in a new generator
+	TerrainGraph m_TerrainEdit;                                   // terrain as edited in the UI
+	std::string m_TerrainError;                                   // why the most recent edit (or load) was rejected
+	char m_TerrainPath[256] = "assets/terrain/default.terrain";
+	uint64_t m_TerrainChangeFrom = 0;                             // version of the terrain before the most recent change
+	uint64_t m_TerrainCommitVersion = 0;                          // version of the terrain most recently committed (see CommitTerrain())
+	bool m_TerrainEditPending = false;                            // true => m_TerrainEdit has changes that the chunk generator does not have yet
+	bool m_TerrainCommitPending = false;                          // true => an edit has finished, but has not been committed yet
+	bool m_LiveTuning = false;                                    // true => chunks keep their layers, so that terrain edits regenerate only what they affect
 
 	Hazel::Scope<Hazel::OrthographicCamera> m_Camera;
 	uint32_t m_ViewportWidth;
@@ -95,40 +171,97 @@ private:
 
 	Hazel::Ref<Hazel::Texture2D> m_BackgroundSheet;
 	Hazel::Ref<Hazel::Texture2D> m_PlayerSheet;
-	std::vector<Hazel::Ref<Hazel::SubTexture2D>> m_GroundTextures;
-	std::vector<Hazel::Ref<Hazel::SubTexture2D>> m_TreeTextures;
+	std::vector<Hazel::Ref<Hazel::SubTexture2D>, TaggedAllocator<Hazel::Ref<Hazel::SubTexture2D>, MemoryTag::Renderer>> m_GroundTextures;
+	std::vector<Hazel::Ref<Hazel::SubTexture2D>, TaggedAllocator<Hazel::Ref<Hazel::SubTexture2D>, MemoryTag::Renderer>> m_TreeTextures;
 	Hazel::Ref<Hazel::SubTexture2D> m_TreeShadowTexture;
 
-	std::vector<Hazel::Ref<Hazel::SubTexture2D>> m_PlayerSprites;
-	std::vector<std::vector<uint8_t>> m_PlayerAnimations;
+	std::vector<Hazel::Ref<Hazel::SubTexture2D>, TaggedAllocator<Hazel::Ref<Hazel::SubTexture2D>, MemoryTag::Renderer>> m_PlayerSprites;
+
+	// The above, as registered with m_QuadBatch
+	std::vector<QuadSprite, TaggedAllocator<QuadSprite, MemoryTag::Renderer>> m_GroundQuadSprites;
+	std::vector<QuadSprite, TaggedAllocator<QuadSprite, MemoryTag::Renderer>> m_TreeQuadSprites;
+	QuadSprite m_TreeShadowQuadSprite;
+	std::vector<QuadSprite, TaggedAllocator<QuadSprite, MemoryTag::Renderer>> m_PlayerQuadSprites;
+
+	static constexpr int GroundRowsPerRange = 8;                  // work is split into ranges of (at most) this many ground rows, trees, or actors
+	static constexpr size_t TreesPerRange = 1024;
+	static constexpr size_t ActorsPerRange = 4096;
+	QuadBatch m_QuadBatch;
+	bool m_ParallelQuads = true;
+	float m_QuadBuildTime = 0.0f;                                 // milliseconds taken to build the most recent frame's quads
+	float m_QuadSubmitTime = 0.0f;                                // ... and to draw them
 
 	bool m_StopThreads;                                           // Setting this to true will terminate helper threads (e.g. the Chunk Generator thread)
 	std::thread m_ChunkGenerator;                                 // Thread is started in OnAttach(), and runs until m_StopThreads is true.  Need to store this thread handle so that OnDetach() can wait for exit.
-	std::thread m_ChunkEraser;                                    // Thread is started in OnAttach(), and runs until m_StopThreads is true.  Need to store this thread handle so that OnDetach() can wait for exit.
 	HZ_PROFILE_LOCK(std::mutex, m_ChunkMutex, "Chunk Mutex");     // Synch access to chunk data
 	std::condition_variable_any m_ChunkGeneratorCV;               // Notified when there are some chunks that require generation
-	std::condition_variable_any m_ChunkEraserCV;                  // Notified when there are some chunks that require erasure
-	std::unordered_set<std::pair<int, int>> m_ChunksToGenerate;   // "queue" of chunks to generate. (implemented as a set.  It doesn't matter what order we do them in, and unordered_set makes it easy and efficient to prevent adding same chunk more than once)
-	std::unordered_set<std::pair<int, int>> m_ChunksToErase;      // "queue" of chunks to erase. (implemented as a set.  It doesn't matter what order we do them in, and unordered_set makes it easy and efficient to prevent adding same chunk more than once)
-
-	uint32_t m_ChunkWidth;
-	uint32_t m_ChunkHeight;
-	std::unordered_map<std::pair<int, int>, std::vector<uint8_t>> m_GroundType;
-	std::unordered_map<std::pair<int, int>, std::vector<uint8_t>> m_TreeType;
-	std::unordered_map<std::pair<int, int>, std::vector<glm::vec3>> m_TreeCoords;
-	std::unordered_map<std::pair<int, int>, std::vector<glm::vec2>> m_TreeScale;
-	std::unordered_map<std::pair<int, int>, std::vector<glm::vec3>> m_TreeShadowCoords;
-	std::unordered_map<std::pair<int, int>, std::vector<glm::vec2>> m_TreeShadowSize;
-
-	glm::vec2 m_PlayerPos;
-	glm::vec2 m_PlayerSize;
-	PlayerState m_PlayerState;
-	uint32_t m_PlayerFrame;
+	std::deque<ChunkRequest, TaggedAllocator<ChunkRequest, MemoryTag::ChunkIndex>> m_ChunksToGenerate;  // queue of chunks to generate.  (no need to check for duplicates, a chunk is only queued when it claims its grid slot)
+	ChunkStats m_ChunkStats;
+	uint32_t m_RegenerationsPending = 0;                          // regeneration requests queued or in progress
+	std::chrono::steady_clock::time_point m_TerrainChangeTime;    // when the terrain was most recently changed
+	float m_RegenerationLatency = 0.0f;                           // milliseconds from the most recent terrain change until every resident chunk was up to date with it
+
+	uint32_t m_ChunkSize = 32;                                    // Chunks are this many tiles square, and do not overlap.  (changed only while the generator is idle, see SetChunkLayout())
+	uint32_t m_ChunkRadius = 1;                                   // Chunks within this many chunks of the player's chunk are kept resident (more if that is not enough to cover the view)
+	ChunkGrid<Hazel::Ref<Chunk>> m_Chunks;                        // Resident chunks.  A chunk's data is never modified once published, so the render thread can hang on to a Ref without holding the lock
+	std::vector<Hazel::Ref<Chunk>> m_VisibleChunks;               // chunks covering the view this frame, row major.  (kept as a member so that its storage is reused from one frame to the next)
+
+	Simulation m_Simulation;
+	SimulationState m_PreviousSimulationState;                    // state before the most recent tick (when simulation is stepped by OnUpdate())
+	float m_SimulationAccumulator = 0.0f;                         // time not yet consumed by simulation ticks (when simulation is stepped by OnUpdate())
+	bool m_ThreadedSimulation = false;                            // true => simulation is stepped by m_SimulationThread rather than OnUpdate()
+	std::thread m_SimulationThread;
+	std::atomic<bool> m_StopSimulationThread = false;
+	std::atomic<uint8_t> m_LatestInput = 0;                       // input sampled by the render thread, for the simulation thread to pick up
+	Hazel::Ref<const WorldGenerator> m_CollisionGenerator;        // generator that collision is worked out with this tick.  (only used by whichever thread steps the simulation)
+	Hazel::Ref<const ChunkNav> m_CollisionNav;                    // navigation chunk that collision was most recently read from (ditto)
+	SimulationStateBuffer m_SimulationBuffer;                     // state published by the simulation thread, for the render thread to pick up
+	SimulationState m_PublishedPreviousState;                     // most recent states read from m_SimulationBuffer.  (kept as members so that their storage is reused from one frame to the next)
+	SimulationState m_PublishedState;
+	SimulationStats m_PublishedStats;
+	int m_ActorCount = 10000;                                     // number of actors to spawn
+	int m_AnimationRadius = 2;                                    // actors within this many chunks of the player's chunk are animated.  (a setting of its own, independent of the view)
+	static constexpr float ActorSpawnRadius = 200.0f;             // actors are spawned within this many tiles of the origin
+	float m_AnimationTime = 0.0f;                                 // milliseconds taken by the most recent (rendered) animation update
+
+	Minimap m_Minimap;
+
+	Pathfinder m_Pathfinder;
+	bool m_Collision = true;
+	Random m_Random;
+	int m_PathQueryCount = 1000;                                  // number of queries to submit for a pathfinding benchmark
+	uint64_t m_PathQueriesPending = 0;                            // benchmark queries submitted but not yet completed
+	std::chrono::steady_clock::time_point m_PathBenchmarkStart;
+	float m_PathBenchmarkTime = 0.0f;                             // seconds taken by the most recent benchmark
+	uint64_t m_PathBenchmarkFound = 0;                            // number of queries in most recent benchmark that found a path
+	std::vector<PathResult> m_PathResults;                        // (kept as a member so that its storage is reused from one frame to the next)
+
+	static constexpr uint32_t ReplaySeed = 12345;                 // simulation seed for recordings and scripted paths
+	InputMode m_InputMode = InputMode::Live;
+	InputRecording m_Recording;
+	ScriptedPath m_ScriptedPath;
+	std::atomic<bool> m_ReplayFinished = false;                   // set by the simulation when it reaches the end of a replay
+	char m_RecordingPath[256] = "input.nrin";
+	std::vector<float> m_FrameTimes;                              // milliseconds, for each frame of the current replay
+	std::string m_ReplayReport;                                   // results of the most recent replay
+
+#ifdef NIRNIA_TRACK_MEMORY
+	MemoryTracker::Snapshot m_MemorySnapshot;                     // snapshot at the start of the current allocation rate sample
+	float m_MemorySampleTime = 0.0f;                              // seconds since m_MemorySnapshot was taken
+	uint64_t m_MemorySampleFrames = 0;                            // frames since m_MemorySnapshot was taken
+	float m_MemoryByteRates[static_cast<int>(MemoryTag::NumTags)] = {};        // bytes allocated per second, over the previous sample
+	float m_MemoryAllocationRates[static_cast<int>(MemoryTag::NumTags)] = {};  // allocations per frame, over the previous sample
+	char m_MemorySnapshotPath[256] = "memory.json";
+#endif
+
+	glm::vec2 m_PlayerPos;                                        // player position interpolated between the two most recent simulation ticks
+	uint64_t m_SimulationTick = 0;                                // simulation tick most recently rendered
 
 	std::pair<int, int> m_PrevChunk;
 
+	static constexpr float MinZoom = 2.0f;
+	static constexpr float MaxZoom = 16.0f;
 	float m_AspectRatio = 1.0f;
-	float m_Zoom = 4.0f;
-	float m_AnimationAccumulator = 0.0f;
+	float m_Zoom = 4.0f;                                          // half height of the view, in tiles
 
 };
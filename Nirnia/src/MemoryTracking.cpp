@@ -0,0 +1,158 @@
+#include "MemoryTracking.h"
+
+#ifdef NIRNIA_TRACK_MEMORY
+
+#include <atomic>
+#include <sstream>
+
+namespace {
+
+	struct AtomicTagStats {
+		std::atomic<uint64_t> LiveBytes = 0;
+		std::atomic<uint64_t> PeakBytes = 0;
+		std::atomic<uint64_t> AllocatedBytes = 0;
+		std::atomic<uint64_t> Allocations = 0;
+	};
+
+	// Function local static, so that it is constructed before the first allocation (which may well happen during
+	// static initialization of some other translation unit)
+	AtomicTagStats* GetStats() {
+		static AtomicTagStats stats[static_cast<int>(MemoryTag::NumTags)];
+		return stats;
+	}
+
+	// Untagged allocations have their size stored in a header in front of the memory handed out, so that it is known
+	// when they are freed.  The header is a full max_align_t, so that alignment is preserved.
+	constexpr size_t HeaderSize = alignof(std::max_align_t);
+
+	void* AllocateUntagged(const size_t bytes) {
+		void* memory = std::malloc(HeaderSize + bytes);
+		if (!memory) {
+			return nullptr;
+		}
+		*static_cast<size_t*>(memory) = bytes;
+		MemoryTracker::Allocate(MemoryTag::Untagged, bytes);
+		return static_cast<char*>(memory) + HeaderSize;
+	}
+
+	void FreeUntagged(void* memory) {
+		if (memory) {
+			void* header = static_cast<char*>(memory) - HeaderSize;
+			MemoryTracker::Free(MemoryTag::Untagged, *static_cast<size_t*>(header));
+			std::free(header);
+		}
+	}
+
+}
+
+
+namespace MemoryTracker {
+
+	const char* GetTagName(const MemoryTag tag) {
+		static const char* names[static_cast<int>(MemoryTag::NumTags)] = {
+			"ChunkGround",
+			"ChunkTrees",
+			"ChunkLayers",
+			"ChunkIndex",
+			"Textures",
+			"Renderer",
+			"Untagged"
+		};
+		return names[static_cast<int>(tag)];
+	}
+
+
+	void Allocate(const MemoryTag tag, const size_t bytes) {
+		AtomicTagStats& stats = GetStats()[static_cast<int>(tag)];
+		uint64_t live = stats.LiveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		uint64_t peak = stats.PeakBytes.load(std::memory_order_relaxed);
+		while ((live > peak) && !stats.PeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+		stats.AllocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+		stats.Allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+
+	void Free(const MemoryTag tag, const size_t bytes) {
+		GetStats()[static_cast<int>(tag)].LiveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+
+
+	Snapshot GetSnapshot() {
+		Snapshot snapshot;
+		for (int tag = 0; tag < static_cast<int>(MemoryTag::NumTags); ++tag) {
+			const AtomicTagStats& stats = GetStats()[tag];
+			snapshot.Tags[tag].LiveBytes = stats.LiveBytes.load(std::memory_order_relaxed);
+			snapshot.Tags[tag].PeakBytes = stats.PeakBytes.load(std::memory_order_relaxed);
+			snapshot.Tags[tag].AllocatedBytes = stats.AllocatedBytes.load(std::memory_order_relaxed);
+			snapshot.Tags[tag].Allocations = stats.Allocations.load(std::memory_order_relaxed);
+		}
+		return snapshot;
+	}
+
+
+	std::string GetSnapshotJson() {
+		Snapshot snapshot = GetSnapshot();
+		std::ostringstream json;
+		json << "{\n";
+		for (int tag = 0; tag < static_cast<int>(MemoryTag::NumTags); ++tag) {
+			const TagStats& stats = snapshot.Tags[tag];
+			json << "  \"" << GetTagName(static_cast<MemoryTag>(tag)) << "\": {"
+				<< "\"liveBytes\": " << stats.LiveBytes << ", "
+				<< "\"peakBytes\": " << stats.PeakBytes << ", "
+				<< "\"allocatedBytes\": " << stats.AllocatedBytes << ", "
+				<< "\"allocations\": " << stats.Allocations << "}"
+				<< ((tag + 1 < static_cast<int>(MemoryTag::NumTags)) ? ",\n" : "\n");
+		}
+		json << "}\n";
+		return json.str();
+	}
+
+}
+
+
+// Replacements for the global allocation functions, so that all other heap traffic is counted as Untagged.
+// (the aligned forms are not replaced.  They are rarely used, and pair up with their own delete)
+void* operator new(size_t bytes) {
+	if (void* memory = AllocateUntagged(bytes)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t bytes) {
+	return operator new(bytes);
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept {
+	return AllocateUntagged(bytes);
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept {
+	return AllocateUntagged(bytes);
+}
+
+void operator delete(void* memory) noexcept {
+	FreeUntagged(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	FreeUntagged(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	FreeUntagged(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	FreeUntagged(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	FreeUntagged(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	FreeUntagged(memory);
+}
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Subsystems that memory use is reported for
+enum class MemoryTag : uint8_t {
+	ChunkGround,    // chunk ground types
+	ChunkTrees,     // chunk trees
+	ChunkLayers,    // intermediate generation results (kept with chunks while the terrain is being tuned)
+	ChunkIndex,     // chunk grids and generation queues
+	Textures,       // texture data (as uploaded) and sub-textures
+	Renderer,       // render data built by the game (not Hazel's internal buffers)
+	Untagged,       // everything else that goes through operator new
+
+	NumTags
+};
+
+
+// Allocation tracking is compiled in only when NIRNIA_TRACK_MEMORY is defined (which it is for the Profile
+// configuration, alongside HZ_PROFILE).  Otherwise, TaggedAllocator<T, Tag> is just std::allocator<T> and the
+// NIRNIA_TRACK_* macros expand to nothing, so there is no overhead at all.
+#ifdef NIRNIA_TRACK_MEMORY
+
+#include <cstdlib>
+#include <new>
+
+namespace MemoryTracker {
+
+	struct TagStats {
+		uint64_t LiveBytes = 0;
+		uint64_t PeakBytes = 0;
+		uint64_t AllocatedBytes = 0;    // total ever allocated
+		uint64_t Allocations = 0;       // total number of allocations ever made
+	};
+
+	struct Snapshot {
+		TagStats Tags[static_cast<int>(MemoryTag::NumTags)];
+	};
+
+	const char* GetTagName(const MemoryTag tag);
+
+	void Allocate(const MemoryTag tag, const size_t bytes);
+	void Free(const MemoryTag tag, const size_t bytes);
+
+	Snapshot GetSnapshot();
+
+	// Snapshot as a JSON object, keyed by tag name
+	std::string GetSnapshotJson();
+
+}
+
+
+// std compatible allocator that accounts everything it allocates to a tag.
+// Memory comes straight from malloc (rather than operator new), so that it is not also counted as Untagged.
+template<typename T, MemoryTag Tag>
+class TrackingAllocator
+{
+public:
+	using value_type = T;
+
+	template<typename U>
+	struct rebind {
+		using other = TrackingAllocator<U, Tag>;
+	};
+
+	TrackingAllocator() = default;
+
+	template<typename U>
+	TrackingAllocator(const TrackingAllocator<U, Tag>&) {}
+
+	T* allocate(const size_t n) {
+		void* memory = std::malloc(n * sizeof(T));
+		if (!memory) {
+			throw std::bad_alloc();
+		}
+		MemoryTracker::Allocate(Tag, n * sizeof(T));
+		return static_cast<T*>(memory);
+	}
+
+	void deallocate(T* memory, const size_t n) {
+		MemoryTracker::Free(Tag, n * sizeof(T));
+		std::free(memory);
+	}
+
+	template<typename U>
+	bool operator==(const TrackingAllocator<U, Tag>&) const { return true; }
+
+	template<typename U>
+	bool operator!=(const TrackingAllocator<U, Tag>&) const { return false; }
+};
+
+template<typename T, MemoryTag Tag>
+using TaggedAllocator = TrackingAllocator<T, Tag>;
+
+// For memory that is not allocated by us (e.g. textures, which Hazel allocates), but that we know the size of
+#define NIRNIA_TRACK_ALLOCATION(tag, bytes) ::MemoryTracker::Allocate(tag, bytes)
+#define NIRNIA_TRACK_FREE(tag, bytes) ::MemoryTracker::Free(tag, bytes)
+
+#else
+
+template<typename T, MemoryTag Tag>
+using TaggedAllocator = std::allocator<T>;
+
+#define NIRNIA_TRACK_ALLOCATION(tag, bytes)
+#define NIRNIA_TRACK_FREE(tag, bytes)
+
+#endif
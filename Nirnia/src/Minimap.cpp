@@ -0,0 +1,313 @@
+#include "Minimap.h"
+
+#include "Navigation.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+	constexpr uint32_t GetColour(const uint8_t r, const uint8_t g, const uint8_t b) {
+		return r | (g << 8) | (b << 16) | (0xFFu << 24);
+	}
+
+	constexpr uint32_t WaterColour = GetColour(58, 110, 196);
+	constexpr uint32_t GrassColour = GetColour(110, 168, 72);
+	constexpr uint32_t DirtColour = GetColour(168, 136, 88);
+	constexpr uint32_t ForestColour = GetColour(38, 96, 46);
+	constexpr float ForestDensity = 0.25f;          // trees per tile
+
+	// Ground types up to 80 give the terrain at the tile's four corners as base 3 digits (top left, top right, bottom
+	// left, bottom right.  0 water, 1 grass, 2 dirt), and those above are variations of grass.  (see
+	// MainLayer::InitGroundTextures())  The top right corner is the terrain at the sampled tile itself.
+	uint32_t Classify(const uint8_t groundType, const float treeDensity) {
+		const int terrain = (groundType > 80) ? 1 : (groundType / 9) % 3;
+		if (terrain == 0) {
+			return WaterColour;
+		}
+		if (treeDensity >= ForestDensity) {
+			return ForestColour;
+		}
+		return (terrain == 1) ? GrassColour : DirtColour;
+	}
+
+
+	constexpr float MinScale = Minimap::BaseStride / 4.0f;
+	constexpr float MaxScale = (Minimap::BaseStride << (Minimap::NumLevels - 1)) * 2.0f;
+
+}
+
+
+Minimap::~Minimap() {
+	Stop();
+}
+
+
+void Minimap::Start(std::function<bool()> isBusy) {
+	m_IsBusy = std::move(isBusy);
+	m_StopThread = false;
+	m_Worker = std::thread(&Minimap::Worker, this);
+}
+
+
+void Minimap::Stop() {
+	if (m_Worker.joinable()) {
+		{
+			std::lock_guard lock(m_Mutex);
+			HZ_PROFILE_LOCKMARKER(m_Mutex);
+			m_StopThread = true;
+		}
+		m_WorkerCV.notify_all();
+		m_Worker.join();
+	}
+	NIRNIA_TRACK_FREE(MemoryTag::Textures, m_Tiles.size() * TileSize * TileSize * sizeof(uint32_t));
+	m_Tiles.clear();
+	m_Built.clear();
+}
+
+
+void Minimap::SetGenerator(Hazel::Ref<const WorldGenerator> generator) {
+	{
+		std::lock_guard lock(m_Mutex);
+		HZ_PROFILE_LOCKMARKER(m_Mutex);
+		m_Generator = std::move(generator);
+		++m_Version;
+		m_Built.clear();
+	}
+	m_WorkerCV.notify_one();
+}
+
+
+Minimap::Stats Minimap::GetStats() {
+	std::lock_guard lock(m_Mutex);
+	HZ_PROFILE_LOCKMARKER(m_Mutex);
+	m_Stats.CachedTiles = m_Tiles.size();
+	m_Stats.WantedTiles = m_Wanted.size();
+	return m_Stats;
+}
+
+
+void Minimap::Draw(const glm::vec2& player) {
+	HZ_PROFILE_FUNCTION();
+
+	++m_Frame;
+	UploadTiles();
+
+	ImGui::Checkbox("Follow Player", &m_FollowPlayer);
+	ImGui::SameLine();
+	ImGui::Text("%.1f tiles per pixel", m_Scale);
+	if (m_FollowPlayer) {
+		m_Centre = player;
+	}
+
+	// The map is an invisible button, so that it can be dragged
+	const ImVec2 available = ImGui::GetContentRegionAvail();
+	const glm::vec2 size = {std::max(available.x, 32.0f), std::max(available.y, 32.0f)};
+	const ImVec2 cursor = ImGui::GetCursorScreenPos();
+	const glm::vec2 origin = {cursor.x, cursor.y};
+	ImGui::InvisibleButton("Map", ImVec2(size.x, size.y));
+	if (ImGui::IsItemActive() && ImGui::IsMouseDragging(0)) {
+		const ImVec2 delta = ImGui::GetIO().MouseDelta;
+		m_Centre += glm::vec2{-delta.x, delta.y} * m_Scale;
+		m_FollowPlayer = false;
+	}
+	if (ImGui::IsItemHovered() && (ImGui::GetIO().MouseWheel != 0.0f)) {
+		m_Scale = std::clamp(m_Scale * std::pow(0.8f, ImGui::GetIO().MouseWheel), MinScale, MaxScale);
+	}
+
+	// Finest level whose pixels are no smaller than the screen's
+	int level = 0;
+	while ((level + 1 < NumLevels) && (GetStride(level) < m_Scale)) {
+		++level;
+	}
+	auto toScreen = [&](const glm::vec2& world) {
+		const glm::vec2 offset = (world - m_Centre) / m_Scale;
+		return origin + (size * 0.5f) + glm::vec2{offset.x, -offset.y};
+	};
+
+	const glm::vec2 worldMin = m_Centre - (size * (0.5f * m_Scale));
+	const glm::vec2 worldMax = m_Centre + (size * (0.5f * m_Scale));
+	const float tileWorldSize = static_cast<float>(TileSize * GetStride(level));
+	const int iMin = static_cast<int>(std::floor(worldMin.x / tileWorldSize));
+	const int iMax = static_cast<int>(std::floor(worldMax.x / tileWorldSize));
+	const int jMin = static_cast<int>(std::floor(worldMin.y / tileWorldSize));
+	const int jMax = static_cast<int>(std::floor(worldMax.y / tileWorldSize));
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->PushClipRect(ImVec2(origin.x, origin.y), ImVec2(origin.x + size.x, origin.y + size.y), true);
+	drawList->AddRectFilled(ImVec2(origin.x, origin.y), ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(24, 24, 24, 255));
+	for (int j = jMin; j <= jMax; ++j) {
+		for (int i = iMin; i <= iMax; ++i) {
+			const glm::vec2 topLeft = toScreen({i * tileWorldSize, (j + 1) * tileWorldSize});
+			const glm::vec2 bottomRight = toScreen({(i + 1) * tileWorldSize, j * tileWorldSize});
+			DrawTile(level, i, j, topLeft, bottomRight);
+		}
+	}
+	const glm::vec2 playerPos = toScreen(player);
+	drawList->AddCircleFilled(ImVec2(playerPos.x, playerPos.y), 4.0f, IM_COL32(230, 40, 40, 255));
+	drawList->PopClipRect();
+
+	// Tiles to build: first a coarse overview of the whole view (a few tiles, so it fills in quickly), then the
+	// tiles for this level, from the centre out, plus a margin so that panning (or the player moving) finds them
+	// ready
+	const uint64_t version = m_Version;   // (only changed on this thread)
+	std::vector<TileKey> wanted;
+	auto want = [&](const TileKey& key) {
+		auto tile = m_Tiles.find(key);
+		if ((tile == m_Tiles.end()) || (tile->second.Version != version)) {
+			wanted.push_back(key);
+		}
+	};
+	const int overview = std::min(level + 2, NumLevels - 1);
+	const int scale = 1 << (overview - level);
+	for (int j = NavLayout::FloorDiv(jMin, scale); j <= NavLayout::FloorDiv(jMax, scale); ++j) {
+		for (int i = NavLayout::FloorDiv(iMin, scale); i <= NavLayout::FloorDiv(iMax, scale); ++i) {
+			want({overview, i, j});
+		}
+	}
+	const size_t overviewCount = wanted.size();
+	for (int j = jMin - 1; j <= jMax + 1; ++j) {
+		for (int i = iMin - 1; i <= iMax + 1; ++i) {
+			want({level, i, j});
+		}
+	}
+	const glm::vec2 centreTile = m_Centre / tileWorldSize;
+	std::sort(wanted.begin() + overviewCount, wanted.end(), [&](const TileKey& a, const TileKey& b) {
+		return glm::length(glm::vec2{a.I + 0.5f, a.J + 0.5f} - centreTile) < glm::length(glm::vec2{b.I + 0.5f, b.J + 0.5f} - centreTile);
+	});
+	{
+		std::lock_guard lock(m_Mutex);
+		HZ_PROFILE_LOCKMARKER(m_Mutex);
+		wanted.erase(std::remove_if(wanted.begin(), wanted.end(), [&](const TileKey& key) {
+			return (m_Building && (key == m_BuildingKey)) ||
+				std::any_of(m_Built.begin(), m_Built.end(), [&](const BuiltTile& built) { return built.Key == key; });
+		}), wanted.end());
+		m_Wanted = std::move(wanted);
+	}
+	m_WorkerCV.notify_one();
+
+	EvictTiles();
+}
+
+
+bool Minimap::DrawTile(const int level, const int i, const int j, const glm::vec2& min, const glm::vec2& max) {
+	for (int coarser = level; coarser < NumLevels; ++coarser) {
+		const int scale = 1 << (coarser - level);
+		const int parentI = NavLayout::FloorDiv(i, scale);
+		const int parentJ = NavLayout::FloorDiv(j, scale);
+		auto tile = m_Tiles.find({coarser, parentI, parentJ});
+		if (tile == m_Tiles.end()) {
+			continue;
+		}
+		tile->second.LastDrawn = m_Frame;
+
+		// Part of the parent that covers the tile.  (images are bottom row first, so v runs up the screen)
+		const float u0 = static_cast<float>(i - (parentI * scale)) / scale;
+		const float v0 = static_cast<float>(j - (parentJ * scale)) / scale;
+		const float extent = 1.0f / scale;
+		ImTextureID texture = reinterpret_cast<ImTextureID>(static_cast<intptr_t>(tile->second.Texture->GetRendererID()));
+		ImGui::GetWindowDrawList()->AddImage(texture, ImVec2(min.x, min.y), ImVec2(max.x, max.y), ImVec2(u0, v0 + extent), ImVec2(u0 + extent, v0));
+		return true;
+	}
+	return false;
+}
+
+
+void Minimap::UploadTiles() {
+	HZ_PROFILE_FUNCTION();
+
+	std::vector<BuiltTile> built;
+	{
+		std::lock_guard lock(m_Mutex);
+		HZ_PROFILE_LOCKMARKER(m_Mutex);
+		const size_t count = std::min(m_Built.size(), static_cast<size_t>(UploadsPerFrame));
+		built.assign(std::make_move_iterator(m_Built.begin()), std::make_move_iterator(m_Built.begin() + count));
+		m_Built.erase(m_Built.begin(), m_Built.begin() + count);
+	}
+	for (BuiltTile& tile : built) {
+		auto [entry, inserted] = m_Tiles.try_emplace(tile.Key);
+		if (inserted) {
+			entry->second.Texture = Hazel::Texture2D::Create(TileSize, TileSize);
+			NIRNIA_TRACK_ALLOCATION(MemoryTag::Textures, TileSize * TileSize * sizeof(uint32_t));
+		}
+		entry->second.Texture->SetData(tile.Pixels.data(), static_cast<uint32_t>(tile.Pixels.size() * sizeof(uint32_t)));
+		entry->second.Version = tile.Version;
+		entry->second.LastDrawn = m_Frame;
+	}
+}
+
+
+void Minimap::EvictTiles() {
+	if (m_Tiles.size() <= MaxCachedTiles) {
+		return;
+	}
+	std::vector<std::pair<uint64_t, TileKey>> tiles;
+	tiles.reserve(m_Tiles.size());
+	for (const auto& [key, tile] : m_Tiles) {
+		tiles.push_back({tile.LastDrawn, key});
+	}
+	const size_t excess = m_Tiles.size() - MaxCachedTiles;
+	std::nth_element(tiles.begin(), tiles.begin() + excess, tiles.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	for (size_t n = 0; n < excess; ++n) {
+		m_Tiles.erase(tiles[n].second);
+		NIRNIA_TRACK_FREE(MemoryTag::Textures, TileSize * TileSize * sizeof(uint32_t));
+	}
+}
+
+
+void Minimap::BuildTile(const WorldGenerator& generator, const TileKey& key, TilePixels& pixels, std::vector<uint8_t>& groundTypes, std::vector<float>& treeDensity) {
+	HZ_PROFILE_FUNCTION();
+
+	const int stride = GetStride(key.Level);
+	generator.Sample(key.I * TileSize * stride, key.J * TileSize * stride, TileSize, TileSize, stride, groundTypes, treeDensity);
+	pixels.resize(static_cast<size_t>(TileSize) * TileSize);
+	for (size_t index = 0; index < pixels.size(); ++index) {
+		pixels[index] = Classify(groundTypes[index], treeDensity[index]);
+	}
+}
+
+
+void Minimap::Worker() {
+	std::vector<uint8_t> groundTypes;
+	std::vector<float> treeDensity;
+	for (;;) {
+		// Chunks come first.  Nothing says when the chunk generator falls idle, so the worker checks back now and then.
+		const bool isBusy = m_IsBusy && m_IsBusy();
+
+		std::unique_lock lock(m_Mutex);
+		HZ_PROFILE_LOCKMARKER(m_Mutex);
+		if (isBusy) {
+			m_WorkerCV.wait_for(lock, BusyPollInterval, [this] { return m_StopThread; });
+		} else {
+			m_WorkerCV.wait(lock, [this] { return m_StopThread || (m_Generator && !m_Wanted.empty()); });
+		}
+		if (m_StopThread) {
+			return;
+		}
+		if (isBusy) {
+			continue;
+		}
+		const TileKey key = m_Wanted.front();
+		m_Wanted.erase(m_Wanted.begin());
+		Hazel::Ref<const WorldGenerator> generator = m_Generator;
+		const uint64_t version = m_Version;
+		m_Building = true;
+		m_BuildingKey = key;
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		BuiltTile tile = {key, version};
+		BuildTile(*generator, key, tile.Pixels, groundTypes, treeDensity);
+		float time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		lock.lock();
+		m_Building = false;
+		++m_Stats.TilesBuilt;
+		m_Stats.BuildTime += time;
+		if (version == m_Version) {
+			m_Built.push_back(std::move(tile));
+		}
+	}
+}
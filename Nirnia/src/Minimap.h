@@ -0,0 +1,137 @@
+#pragma once
+
+#include "MemoryTracking.h"
+#include "WorldGenerator.h"
+
+#include <Hazel/Core/Layer.h>
+#include <Hazel/Renderer/Texture.h>
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Wide area overview of the world.
+//
+// The minimap does not use chunks.  It samples the terrain directly (see WorldGenerator::Sample()) at coarse strides,
+// and colours each sample as water, grass, dirt, or forest (where trees grow densely).  The images are cached as a
+// pyramid of small square tiles: a level 0 pixel is BaseStride tiles of the world across, and each level up doubles
+// that.  Every level is sampled straight from the terrain, so a coarse tile costs no more to build than a fine one,
+// and does not need the tiles beneath it.
+//
+// Tiles are built lazily, as the view needs them, on a worker thread that stands aside whenever the chunk generator
+// has work to do.  Until a tile is ready, the part of a coarser tile that covers it is drawn instead.
+class Minimap
+{
+public:
+	struct Stats {
+		uint64_t TilesBuilt = 0;
+		double BuildTime = 0.0;      // total milliseconds spent building tiles
+		size_t CachedTiles = 0;
+		size_t WantedTiles = 0;      // tiles waiting to be built
+	};
+
+	static constexpr int TileSize = 64;                  // pixels square
+	static constexpr int BaseStride = 2;                 // world tiles per pixel, at level 0
+	static constexpr int NumLevels = 6;
+	static constexpr size_t MaxCachedTiles = 512;        // least recently drawn tiles are evicted beyond this
+	static constexpr int UploadsPerFrame = 4;            // most tiles turned into textures in one frame
+
+public:
+	Minimap() = default;
+	~Minimap();
+
+	// Starts the worker thread.  isBusy is called (on the worker) before each tile is built, and while it returns
+	// true the worker waits.
+	void Start(std::function<bool()> isBusy);
+
+	// Stops the worker thread, and releases the textures (so must be called on the render thread)
+	void Stop();
+
+	// Switches to a new terrain.  Tiles are rebuilt as they are needed, the old ones are drawn until then.
+	void SetGenerator(Hazel::Ref<const WorldGenerator> generator);
+
+	// Draws the map into the rest of the current ImGui window, centred on the player (until the user pans away from
+	// it).  Drag to pan, mouse wheel to zoom.  Must be called on the render thread.
+	void Draw(const glm::vec2& player);
+
+	// (render thread only)
+	Stats GetStats();
+
+private:
+	struct TileKey {
+		int Level;
+		int I;
+		int J;
+
+		bool operator==(const TileKey& other) const { return (Level == other.Level) & (I == other.I) & (J == other.J); }
+	};
+
+	struct TileKeyHash {
+		size_t operator()(const TileKey& key) const {
+			return (static_cast<size_t>(static_cast<uint32_t>(key.I)) * 73856093) ^ (static_cast<size_t>(static_cast<uint32_t>(key.J)) * 19349663) ^ (static_cast<size_t>(key.Level) * 83492791);
+		}
+	};
+
+	// RGBA8, row major, bottom row first.  (staging only: the textures uploaded from them are what count as Textures)
+	using TilePixels = std::vector<uint32_t, TaggedAllocator<uint32_t, MemoryTag::Renderer>>;
+
+	struct Tile {
+		Hazel::Ref<Hazel::Texture2D> Texture;
+		uint64_t Version;            // m_Version that the image was built for
+		uint64_t LastDrawn;          // frame
+	};
+
+	// A tile built by the worker, waiting for the render thread to upload it
+	struct BuiltTile {
+		TileKey Key;
+		uint64_t Version;
+		TilePixels Pixels;
+	};
+
+	static constexpr auto BusyPollInterval = std::chrono::milliseconds(10);
+
+private:
+	static int GetStride(const int level) { return BaseStride << level; }
+
+	void Worker();
+
+	void BuildTile(const WorldGenerator& generator, const TileKey& key, TilePixels& pixels, std::vector<uint8_t>& groundTypes, std::vector<float>& treeDensity);
+
+	// Turns tiles built by the worker into textures
+	void UploadTiles();
+
+	// Draws tile (i, j) of the given level between corners min and max (on screen), using the finest cached tile that
+	// covers it.  Returns false if there is none.
+	bool DrawTile(const int level, const int i, const int j, const glm::vec2& min, const glm::vec2& max);
+
+	void EvictTiles();
+
+private:
+	// Render thread only
+	std::unordered_map<TileKey, Tile, TileKeyHash> m_Tiles;
+	uint64_t m_Frame = 0;
+	glm::vec2 m_Centre = {0.0f, 0.0f};                   // world position at the centre of the map
+	bool m_FollowPlayer = true;
+	float m_Scale = 4.0f;                                // world tiles per screen pixel
+
+	// Shared with the worker
+	HZ_PROFILE_LOCK(std::mutex, m_Mutex, "Minimap Mutex");
+	std::condition_variable_any m_WorkerCV;              // Notified when there are tiles wanted (or the worker should stop)
+	Hazel::Ref<const WorldGenerator> m_Generator;
+	uint64_t m_Version = 0;                              // bumped by each change of generator
+	std::vector<TileKey> m_Wanted;                       // tiles for the worker to build, most wanted first.  Replaced every frame
+	std::vector<BuiltTile> m_Built;
+	bool m_Building = false;                             // true => worker is building m_BuildingKey
+	TileKey m_BuildingKey = {};
+	Stats m_Stats;
+	std::function<bool()> m_IsBusy;
+	bool m_StopThread = false;
+	std::thread m_Worker;
+};
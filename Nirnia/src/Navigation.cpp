@@ -0,0 +1,104 @@
+#include "Navigation.h"
+
+#include <algorithm>
+
+namespace {
+
+	// Breadth first flood fill of a walkability grid (paths are 4-connected, and every step costs 1)
+	void FloodFill(const std::vector<uint8_t>& walkable, const int width, const int height, const int startX, const int startY, std::vector<uint16_t>& distances, std::vector<uint32_t>& queue) {
+		distances.assign(static_cast<size_t>(width) * height, ChunkNav::Unreachable);
+		queue.clear();
+
+		uint32_t start = startY * width + startX;
+		if (!walkable[start]) {
+			return;
+		}
+		distances[start] = 0;
+		queue.push_back(start);
+		for (size_t head = 0; head < queue.size(); ++head) {
+			uint32_t index = queue[head];
+			int x = index % width;
+			int y = index / width;
+			uint16_t distance = distances[index] + 1;
+			auto visit = [&](const uint32_t neighbour) {
+				if (walkable[neighbour] && (distances[neighbour] == ChunkNav::Unreachable)) {
+					distances[neighbour] = distance;
+					queue.push_back(neighbour);
+				}
+			};
+			if (x > 0) visit(index - 1);
+			if (x < width - 1) visit(index + 1);
+			if (y > 0) visit(index - width);
+			if (y < height - 1) visit(index + width);
+		}
+	}
+
+}
+
+
+void ChunkNav::Build() {
+	Portals.clear();
+
+	// Scans along one edge of the chunk, adding a portal for each run of walkable tiles
+	auto addPortals = [this](const NavSide side, const int length, auto&& tileAt) {
+		int begin = -1;
+		for (int n = 0; n <= length; ++n) {
+			bool walkable = (n < length) && Walkable[tileAt(n).y * Width + tileAt(n).x];
+			if (walkable && (begin < 0)) {
+				begin = n;
+			} else if (!walkable && (begin >= 0)) {
+				glm::ivec2 tile = tileAt((begin + n - 1) / 2);
+				Portals.push_back({side, static_cast<uint16_t>(begin), static_cast<uint16_t>(n - 1), static_cast<uint16_t>(tile.x), static_cast<uint16_t>(tile.y)});
+				begin = -1;
+			}
+		}
+	};
+	addPortals(NavSide::Left, Height, [](const int n) { return glm::ivec2{0, n}; });
+	addPortals(NavSide::Right, Height, [this](const int n) { return glm::ivec2{Width - 1, n}; });
+	addPortals(NavSide::Bottom, Width, [](const int n) { return glm::ivec2{n, 0}; });
+	addPortals(NavSide::Top, Width, [this](const int n) { return glm::ivec2{n, Height - 1}; });
+
+	const size_t numPortals = Portals.size();
+	Distances.assign(numPortals * numPortals, Unreachable);
+	std::vector<uint16_t> field;
+	std::vector<uint32_t> queue;
+	for (size_t from = 0; from < numPortals; ++from) {
+		FloodFill(Walkable, Width, Height, Portals[from].X, Portals[from].Y, field, queue);
+		for (size_t to = 0; to < numPortals; ++to) {
+			Distances[from * numPortals + to] = field[Portals[to].Y * Width + Portals[to].X];
+		}
+	}
+}
+
+
+void ChunkNav::GetDistanceField(const glm::ivec2& from, std::vector<uint16_t>& distances, NavScratch& scratch) const {
+	FloodFill(Walkable, Width, Height, from.x - Left, from.y - Bottom, distances, scratch.Queue);
+}
+
+
+bool ChunkNav::FindPath(const glm::ivec2& from, const glm::ivec2& to, std::vector<glm::ivec2>& path, NavScratch& scratch) const {
+	// Flood fill from the destination, then walk downhill from the start
+	std::vector<uint16_t>& distances = scratch.Distances;
+	FloodFill(Walkable, Width, Height, to.x - Left, to.y - Bottom, distances, scratch.Queue);
+
+	int x = from.x - Left;
+	int y = from.y - Bottom;
+	uint16_t distance = distances[y * Width + x];
+	if (distance == Unreachable) {
+		return false;
+	}
+	while (distance > 0) {
+		--distance;
+		if ((x > 0) && (distances[y * Width + x - 1] == distance)) {
+			--x;
+		} else if ((x < Width - 1) && (distances[y * Width + x + 1] == distance)) {
+			++x;
+		} else if ((y > 0) && (distances[(y - 1) * Width + x] == distance)) {
+			--y;
+		} else {
+			++y;
+		}
+		path.emplace_back(Left + x, Bottom + y);
+	}
+	return true;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Tile coordinates:  tile (x, y) is the ground tile covering world [x - 1, x) x [y - 1, y)
+inline glm::ivec2 GetTile(const glm::vec2& position) {
+	return {static_cast<int>(std::floor(position.x)) + 1, static_cast<int>(std::floor(position.y)) + 1};
+}
+
+
+// How the world is divided up into navigation chunks.
+// Navigation chunk (i, j) covers tiles [OriginX + i * Width, OriginX + (i + 1) * Width) x [OriginY + j * Height, OriginY + (j + 1) * Height)
+struct NavLayout {
+	int OriginX = 0;
+	int OriginY = 0;
+	int Width = 1;
+	int Height = 1;
+
+	int GetChunkI(const int tileX) const { return FloorDiv(tileX - OriginX, Width); }
+	int GetChunkJ(const int tileY) const { return FloorDiv(tileY - OriginY, Height); }
+	int GetLeft(const int i) const { return OriginX + i * Width; }
+	int GetBottom(const int j) const { return OriginY + j * Height; }
+
+	static int FloorDiv(const int a, const int b) { return (a >= 0) ? (a / b) : -((b - 1 - a) / b); }
+};
+
+
+// Chunk edges
+enum class NavSide : uint8_t {
+	Left,
+	Right,
+	Bottom,
+	Top
+};
+
+
+// Working storage for searches within a chunk (kept by the caller, so that it can be reused from one search to the next)
+struct NavScratch {
+	std::vector<uint16_t> Distances;
+	std::vector<uint32_t> Queue;
+};
+
+
+// Walkability of one navigation chunk, plus the chunk's part of the abstract graph used for hierarchical
+// pathfinding.
+//
+// The abstract graph has a node (a "portal") for each maximal run of walkable tiles along each edge of the chunk.
+// The portal sits on the tile in the middle of its run.  Paths between portals of the same chunk are precomputed
+// (Distances).  Paths between portals of neighbouring chunks are found by matching up overlapping runs, at query
+// time (see Pathfinder).
+//
+// ChunkNav is built by the chunk generator, and is immutable once built.
+struct ChunkNav {
+	static constexpr uint16_t Unreachable = 0xFFFF;
+
+	struct Portal {
+		NavSide Side;
+		uint16_t Begin;   // first tile of the run (along the edge, chunk local)
+		uint16_t End;     // last tile of the run (inclusive)
+		uint16_t X;       // tile the portal sits on (chunk local)
+		uint16_t Y;
+	};
+
+	int Left = 0;                      // tile coordinates of bottom left tile
+	int Bottom = 0;
+	int Width = 0;
+	int Height = 0;
+	uint64_t Version = 0;              // version of the terrain that the chunk was generated with
+	std::vector<uint8_t> Walkable;     // 1 => walkable. Row major, Width x Height
+	std::vector<Portal> Portals;
+	std::vector<uint16_t> Distances;   // Portals.size() x Portals.size() path lengths between portals, or Unreachable
+
+	// Finds the portals, and the paths between them, from Walkable
+	void Build();
+
+	bool Contains(const glm::ivec2& tile) const {
+		return (tile.x >= Left) & (tile.x < Left + Width) & (tile.y >= Bottom) & (tile.y < Bottom + Height);
+	}
+
+	bool IsWalkable(const glm::ivec2& tile) const {
+		return Walkable[(tile.y - Bottom) * Width + (tile.x - Left)] != 0;
+	}
+
+	glm::ivec2 GetPortalTile(const uint32_t portal) const {
+		return {Left + Portals[portal].X, Bottom + Portals[portal].Y};
+	}
+
+	uint16_t GetDistance(const uint32_t from, const uint32_t to) const {
+		return Distances[from * Portals.size() + to];
+	}
+
+	// Fills distances (Width x Height) with the length of the shortest path from tile to every other tile in the
+	// chunk, staying within the chunk.  Tiles that cannot be reached are set to Unreachable.
+	void GetDistanceField(const glm::ivec2& from, std::vector<uint16_t>& distances, NavScratch& scratch) const;
+
+	// Finds shortest path from one tile to another, staying within the chunk.
+	// On success, appends the path (excluding from, including to) to path and returns true.
+	bool FindPath(const glm::ivec2& from, const glm::ivec2& to, std::vector<glm::ivec2>& path, NavScratch& scratch) const;
+};
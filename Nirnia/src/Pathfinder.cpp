@@ -0,0 +1,405 @@
+#include "Pathfinder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+
+namespace {
+
+	// Extent of a portal's run along its edge, and the position of the portal itself, in tile coordinates
+	struct EdgeRun {
+		int Begin;
+		int End;
+		int At;
+	};
+
+
+	bool IsVertical(const NavSide side) {
+		return (side == NavSide::Left) || (side == NavSide::Right);
+	}
+
+
+	EdgeRun GetEdgeRun(const ChunkNav& nav, const ChunkNav::Portal& portal) {
+		if (IsVertical(portal.Side)) {
+			return {nav.Bottom + portal.Begin, nav.Bottom + portal.End, nav.Bottom + portal.Y};
+		}
+		return {nav.Left + portal.Begin, nav.Left + portal.End, nav.Left + portal.X};
+	}
+
+
+	NavSide GetOppositeSide(const NavSide side) {
+		switch (side) {
+			case NavSide::Left:   return NavSide::Right;
+			case NavSide::Right:  return NavSide::Left;
+			case NavSide::Bottom: return NavSide::Top;
+			default:              return NavSide::Bottom;
+		}
+	}
+
+
+	glm::ivec2 GetNeighbourOffset(const NavSide side) {
+		switch (side) {
+			case NavSide::Left:   return {-1, 0};
+			case NavSide::Right:  return {1, 0};
+			case NavSide::Bottom: return {0, -1};
+			default:              return {0, 1};
+		}
+	}
+
+
+	// Works out where best to cross from one run to an (adjacent) run in the neighbouring chunk.
+	// Returns false if the runs do not overlap.  Otherwise, crossing is set to the (along the edge) coordinate to
+	// cross at, and cost to the number of steps from one portal to the other.
+	bool GetCrossing(const EdgeRun& from, const EdgeRun& to, int& crossing, uint32_t& cost) {
+		int low = std::max(from.Begin, to.Begin);
+		int high = std::min(from.End, to.End);
+		if (low > high) {
+			return false;
+		}
+		int viaFrom = std::clamp(from.At, low, high);
+		int viaTo = std::clamp(to.At, low, high);
+		uint32_t costFrom = std::abs(from.At - viaFrom) + std::abs(viaFrom - to.At);
+		uint32_t costTo = std::abs(from.At - viaTo) + std::abs(viaTo - to.At);
+		crossing = (costFrom <= costTo) ? viaFrom : viaTo;
+		cost = std::min(costFrom, costTo) + 1;
+		return true;
+	}
+
+
+	uint32_t GetHeuristic(const glm::ivec2& from, const glm::ivec2& to) {
+		return std::abs(from.x - to.x) + std::abs(from.y - to.y);
+	}
+
+}
+
+
+Pathfinder::~Pathfinder() {
+	Stop();
+}
+
+
+void Pathfinder::Start(const uint32_t numThreads) {
+	Stop();
+	m_StopThreads = false;
+	for (uint32_t n = 0; n < numThreads; ++n) {
+		m_Workers.emplace_back(&Pathfinder::Worker, this);
+	}
+}
+
+
+void Pathfinder::Stop() {
+	{
+		std::lock_guard lock(m_QueueMutex);
+		HZ_PROFILE_LOCKMARKER(m_QueueMutex);
+		m_StopThreads = true;
+		m_Requests.clear();
+	}
+	m_QueueCV.notify_all();
+	for (std::thread& worker : m_Workers) {
+		worker.join();
+	}
+	m_Workers.clear();
+}
+
+
+void Pathfinder::SetLayout(const NavLayout& layout, const uint32_t cacheRadius) {
+	std::lock_guard lock(m_ChunkMutex);
+	HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+	m_Layout = layout;
+	m_Chunks.SetRadius(cacheRadius);
+}
+
+
+void Pathfinder::SetCacheRadius(const uint32_t cacheRadius, const int i, const int j) {
+	std::vector<Hazel::Ref<const ChunkNav>> evicted;  // (freed outside of the lock)
+	std::lock_guard lock(m_ChunkMutex);
+	HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+	m_Chunks.Resize(cacheRadius, i, j, evicted);
+}
+
+
+void Pathfinder::AddChunk(const int i, const int j, Hazel::Ref<const ChunkNav> nav) {
+	{
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		uint32_t generation = m_Chunks.Claim(i, j);
+		if (generation == 0) {
+			generation = m_Chunks.GetSlot(i, j).Generation;   // chunk is being replaced by a newer copy of itself
+		}
+		m_Chunks.Publish(i, j, generation, nav);
+	}
+	nav.reset(); // free evicted chunk (if any) outside of the lock
+}
+
+
+Hazel::Ref<const ChunkNav> Pathfinder::GetChunk(const int i, const int j) {
+	std::lock_guard lock(m_ChunkMutex);
+	HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+	const Hazel::Ref<const ChunkNav>* nav = m_Chunks.Find(i, j);
+	return nav ? *nav : nullptr;
+}
+
+
+Hazel::Ref<const ChunkNav> Pathfinder::GetChunkAt(const glm::ivec2& tile) {
+	std::lock_guard lock(m_ChunkMutex);
+	HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+	const Hazel::Ref<const ChunkNav>* nav = m_Chunks.Find(m_Layout.GetChunkI(tile.x), m_Layout.GetChunkJ(tile.y));
+	return nav ? *nav : nullptr;
+}
+
+
+bool Pathfinder::IsWalkable(const glm::ivec2& tile, const bool unknownIsWalkable) {
+	std::lock_guard lock(m_ChunkMutex);
+	HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+	const Hazel::Ref<const ChunkNav>* nav = m_Chunks.Find(m_Layout.GetChunkI(tile.x), m_Layout.GetChunkJ(tile.y));
+	return nav ? (*nav)->IsWalkable(tile) : unknownIsWalkable;
+}
+
+
+bool Pathfinder::FindPath(const glm::ivec2& start, const glm::ivec2& goal, std::vector<glm::ivec2>& path) {
+	return Search(start, goal, path, m_SynchronousContext);
+}
+
+
+void Pathfinder::Submit(const PathRequest& request) {
+	{
+		std::lock_guard lock(m_QueueMutex);
+		HZ_PROFILE_LOCKMARKER(m_QueueMutex);
+		m_Requests.push_back(request);
+	}
+	m_QueueCV.notify_one();
+}
+
+
+void Pathfinder::PollResults(std::vector<PathResult>& results) {
+	std::lock_guard lock(m_QueueMutex);
+	HZ_PROFILE_LOCKMARKER(m_QueueMutex);
+	std::move(m_Results.begin(), m_Results.end(), std::back_inserter(results));
+	m_Results.clear();
+}
+
+
+Pathfinder::Stats Pathfinder::GetStats() {
+	std::lock_guard lock(m_QueueMutex);
+	HZ_PROFILE_LOCKMARKER(m_QueueMutex);
+	return m_Stats;
+}
+
+
+void Pathfinder::Worker() {
+	SearchContext context;
+	for (;;) {
+		PathRequest request;
+		{
+			std::unique_lock lock(m_QueueMutex);
+			m_QueueCV.wait(lock, [&] { return m_StopThreads || !m_Requests.empty(); });
+			HZ_PROFILE_LOCKMARKER(m_QueueMutex);
+			if (m_StopThreads) {
+				break;
+			}
+			request = m_Requests.front();
+			m_Requests.pop_front();
+		}
+
+		HZ_PROFILE_SCOPE("Find Path");
+		PathResult result = {request.Id};
+		auto start = std::chrono::steady_clock::now();
+		result.Found = Search(request.Start, request.Goal, result.Path, context);
+		result.Time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard lock(m_QueueMutex);
+		HZ_PROFILE_LOCKMARKER(m_QueueMutex);
+		++m_Stats.Queries;
+		m_Stats.Found += result.Found;
+		m_Stats.TotalTime += result.Time;
+		m_Results.push_back(std::move(result));
+	}
+}
+
+
+const ChunkNav* Pathfinder::GetChunk(const int i, const int j, SearchContext& context) {
+	// Chunks are looked up in the cache (under the lock) once per query.  The context then holds a Ref to each chunk
+	// used, so that it stays valid for the rest of the query even if it is evicted from the cache in the meantime.
+	for (const auto& [key, nav] : context.Chunks) {
+		if ((key.first == i) && (key.second == j)) {
+			return nav.get();
+		}
+	}
+	Hazel::Ref<const ChunkNav> nav = GetChunk(i, j);
+	context.Chunks.push_back({{i, j}, nav});
+	return nav.get();
+}
+
+
+bool Pathfinder::Search(const glm::ivec2& start, const glm::ivec2& goal, std::vector<glm::ivec2>& path, SearchContext& context) {
+	path.clear();
+	context.Chunks.clear();
+
+	NavLayout layout;
+	{
+		std::lock_guard lock(m_ChunkMutex);
+		HZ_PROFILE_LOCKMARKER(m_ChunkMutex);
+		layout = m_Layout;
+	}
+	const int startI = layout.GetChunkI(start.x);
+	const int startJ = layout.GetChunkJ(start.y);
+	const int goalI = layout.GetChunkI(goal.x);
+	const int goalJ = layout.GetChunkJ(goal.y);
+	const ChunkNav* startNav = GetChunk(startI, startJ, context);
+	const ChunkNav* goalNav = GetChunk(goalI, goalJ, context);
+	if (!startNav || !goalNav || !startNav->IsWalkable(start) || !goalNav->IsWalkable(goal)) {
+		return false;
+	}
+	if (start == goal) {
+		return true;
+	}
+
+	// If start and goal share a chunk, then the path very likely stays within it.
+	// (but if it doesn't, then we need the full search to find a way round through the neighbouring chunks)
+	if ((startNav == goalNav) && startNav->FindPath(start, goal, path, context.Scratch)) {
+		return true;
+	}
+
+	// Abstract search.  The start and goal tiles are temporarily linked into the graph, via distance fields that
+	// give the cost of getting from start to each portal of its chunk (and from each portal of goal's chunk to goal)
+	startNav->GetDistanceField(start, context.StartField, context.Scratch);
+	goalNav->GetDistanceField(goal, context.GoalField, context.Scratch);
+
+	auto& records = context.Records;
+	auto& open = context.Open;
+	records.clear();
+	open.clear();
+
+	auto push = [&](const NodeKey& key, const glm::ivec2& tile, const uint32_t cost, const NodeKey& parent) {
+		auto [record, inserted] = records.try_emplace(key, NodeRecord{cost, parent, tile, false});
+		if (!inserted) {
+			if (record->second.Closed || (cost >= record->second.Cost)) {
+				return;
+			}
+			record->second.Cost = cost;
+			record->second.Parent = parent;
+		}
+		open.push_back({cost + GetHeuristic(tile, goal), cost, key});
+		std::push_heap(open.begin(), open.end(), std::greater<>());
+	};
+
+	const NodeKey startKey = {startI, startJ, StartNode};
+	push(startKey, start, 0, startKey);
+
+	while (!open.empty()) {
+		std::pop_heap(open.begin(), open.end(), std::greater<>());
+		OpenNode node = open.back();
+		open.pop_back();
+
+		NodeRecord& record = records[node.Key];
+		if (record.Closed || (node.Cost != record.Cost)) {
+			continue; // stale entry (node has since been reached more cheaply)
+		}
+		record.Closed = true;
+
+		if (node.Key.Portal == GoalNode) {
+			// Collect the route (goal back to start), and refine it into tiles
+			context.Route.clear();
+			for (NodeKey key = node.Key; !(key == startKey); key = records[key].Parent) {
+				context.Route.push_back(key);
+			}
+			context.Route.push_back(startKey);
+			std::reverse(context.Route.begin(), context.Route.end());
+			return Refine(start, path, context);
+		}
+
+		const ChunkNav& nav = *GetChunk(node.Key.I, node.Key.J, context);
+		const bool isGoalChunk = (node.Key.I == goalI) && (node.Key.J == goalJ);
+
+		if (node.Key.Portal == StartNode) {
+			for (uint32_t to = 0; to < nav.Portals.size(); ++to) {
+				uint16_t distance = context.StartField[nav.Portals[to].Y * nav.Width + nav.Portals[to].X];
+				if (distance != ChunkNav::Unreachable) {
+					push({node.Key.I, node.Key.J, static_cast<int>(to)}, nav.GetPortalTile(to), node.Cost + distance, node.Key);
+				}
+			}
+			continue;
+		}
+
+		const uint32_t from = static_cast<uint32_t>(node.Key.Portal);
+		const ChunkNav::Portal& portal = nav.Portals[from];
+
+		// Other portals of the same chunk
+		for (uint32_t to = 0; to < nav.Portals.size(); ++to) {
+			uint16_t distance = nav.GetDistance(from, to);
+			if ((to != from) && (distance != ChunkNav::Unreachable)) {
+				push({node.Key.I, node.Key.J, static_cast<int>(to)}, nav.GetPortalTile(to), node.Cost + distance, node.Key);
+			}
+		}
+
+		// The goal
+		if (isGoalChunk) {
+			uint16_t distance = context.GoalField[portal.Y * nav.Width + portal.X];
+			if (distance != ChunkNav::Unreachable) {
+				push({goalI, goalJ, GoalNode}, goal, node.Cost + distance, node.Key);
+			}
+		}
+
+		// Portals of the neighbouring chunk, on the other side of the edge
+		glm::ivec2 offset = GetNeighbourOffset(portal.Side);
+		const int neighbourI = node.Key.I + offset.x;
+		const int neighbourJ = node.Key.J + offset.y;
+		if (const ChunkNav* neighbour = GetChunk(neighbourI, neighbourJ, context)) {
+			const NavSide opposite = GetOppositeSide(portal.Side);
+			const EdgeRun run = GetEdgeRun(nav, portal);
+			for (uint32_t to = 0; to < neighbour->Portals.size(); ++to) {
+				int crossing;
+				uint32_t cost;
+				if ((neighbour->Portals[to].Side == opposite) && GetCrossing(run, GetEdgeRun(*neighbour, neighbour->Portals[to]), crossing, cost)) {
+					push({neighbourI, neighbourJ, static_cast<int>(to)}, neighbour->GetPortalTile(to), node.Cost + cost, node.Key);
+				}
+			}
+		}
+	}
+	return false;
+}
+
+
+bool Pathfinder::Refine(const glm::ivec2& start, std::vector<glm::ivec2>& path, SearchContext& context) {
+	// Walks along the edge of a chunk (which, being within a portal's run, is all walkable)
+	auto walkEdge = [&path](glm::ivec2 tile, const int to, const bool vertical) {
+		int& along = vertical ? tile.y : tile.x;
+		const int step = (to > along) ? 1 : -1;
+		while (along != to) {
+			along += step;
+			path.push_back(tile);
+		}
+		return tile;
+	};
+
+	glm::ivec2 tile = start;
+	for (size_t n = 1; n < context.Route.size(); ++n) {
+		const NodeKey& from = context.Route[n - 1];
+		const NodeKey& to = context.Route[n];
+		const glm::ivec2& target = context.Records[to].Tile;
+		const ChunkNav& toNav = *GetChunk(to.I, to.J, context);
+		if ((from.I == to.I) && (from.J == to.J)) {
+			// Within a chunk
+			if (!toNav.FindPath(tile, target, path, context.Scratch)) {
+				return false;
+			}
+		} else {
+			// Across an edge between chunks
+			const ChunkNav& fromNav = *GetChunk(from.I, from.J, context);
+			const ChunkNav::Portal& fromPortal = fromNav.Portals[from.Portal];
+			const ChunkNav::Portal& toPortal = toNav.Portals[to.Portal];
+			const bool vertical = IsVertical(fromPortal.Side);
+			int crossing;
+			uint32_t cost;
+			GetCrossing(GetEdgeRun(fromNav, fromPortal), GetEdgeRun(toNav, toPortal), crossing, cost);
+			tile = walkEdge(tile, crossing, vertical);
+			tile += GetNeighbourOffset(fromPortal.Side);
+			path.push_back(tile);
+			walkEdge(tile, vertical ? target.y : target.x, vertical);
+		}
+		tile = target;
+	}
+	return true;
+}
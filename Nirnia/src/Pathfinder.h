@@ -0,0 +1,169 @@
+#pragma once
+
+#include "ChunkGrid.h"
+#include "Navigation.h"
+
+#include <Hazel/Core/Layer.h>
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// A request to find a path between two tiles
+struct PathRequest {
+	uint64_t Id;
+	glm::ivec2 Start;
+	glm::ivec2 Goal;
+};
+
+
+struct PathResult {
+	uint64_t Id;
+	bool Found;
+	std::vector<glm::ivec2> Path;   // tiles to step through, in order (excluding Start, including Goal)
+	float Time;                     // milliseconds taken to find the path
+};
+
+
+// Hierarchical pathfinding service.
+//
+// Paths are found in two stages.  First, an A* search over the abstract graph of chunk portals (see ChunkNav) gives
+// the sequence of chunks (and where to cross between them).  Then each leg of that route is refined into tiles with
+// a search that is confined to a single chunk.  Both searches are over small graphs, so queries that span many
+// chunks stay cheap.
+//
+// The pathfinder keeps its own cache of chunk navigation data (fed by the chunk generator), separate from the
+// resident map chunks, and with a larger radius.  Paths can only be found through chunks that are in the cache.
+//
+// Queries can either be made synchronously (FindPath()), or submitted to the pathfinder's worker threads, with the
+// results picked up later (PollResults()).
+class Pathfinder
+{
+public:
+	struct Stats {
+		uint64_t Queries = 0;     // queries completed by worker threads
+		uint64_t Found = 0;       // ... of which a path was found
+		double TotalTime = 0.0;   // milliseconds spent on those queries
+	};
+
+public:
+	Pathfinder() = default;
+	~Pathfinder();
+
+	// Starts worker threads for submitted queries
+	void Start(const uint32_t numThreads);
+
+	// Stops worker threads.  Queries still in the queue are dropped.
+	void Stop();
+
+	// Sets how the world is divided up into navigation chunks, and how many chunks around any given chunk are kept
+	// in the cache.  Clears the cache.
+	void SetLayout(const NavLayout& layout, const uint32_t cacheRadius);
+
+	// Changes how many chunks are kept in the cache, keeping the chunks it already holds (nearest to chunk (i, j)
+	// first, if they don't all fit)
+	void SetCacheRadius(const uint32_t cacheRadius, const int i, const int j);
+
+	const NavLayout& GetLayout() const { return m_Layout; }
+
+	// Adds navigation data for chunk (i, j) to the cache, evicting whichever chunk shared its slot
+	void AddChunk(const int i, const int j, Hazel::Ref<const ChunkNav> nav);
+
+	// Returns navigation data for chunk (i, j), or nullptr if it is not in the cache
+	Hazel::Ref<const ChunkNav> GetChunk(const int i, const int j);
+
+	// Returns navigation data for the chunk containing tile, or nullptr if it is not in the cache
+	Hazel::Ref<const ChunkNav> GetChunkAt(const glm::ivec2& tile);
+
+	// Returns whether tile can be walked on.  Tiles in chunks that are not in the cache are deemed walkable if
+	// unknownIsWalkable is true.
+	bool IsWalkable(const glm::ivec2& tile, const bool unknownIsWalkable = true);
+
+	// Finds a path on the calling thread
+	bool FindPath(const glm::ivec2& start, const glm::ivec2& goal, std::vector<glm::ivec2>& path);
+
+	// Queues a query for the worker threads
+	void Submit(const PathRequest& request);
+
+	// Appends results of completed queries to results
+	void PollResults(std::vector<PathResult>& results);
+
+	Stats GetStats();
+
+private:
+	// Identifies a node of the abstract graph.  Portal is an index into the chunk's portals, or one of StartNode, GoalNode
+	struct NodeKey {
+		int I;
+		int J;
+		int Portal;
+
+		bool operator==(const NodeKey& other) const { return (I == other.I) & (J == other.J) & (Portal == other.Portal); }
+	};
+
+	struct NodeKeyHash {
+		size_t operator()(const NodeKey& key) const {
+			return (static_cast<size_t>(static_cast<uint32_t>(key.I)) * 73856093) ^ (static_cast<size_t>(static_cast<uint32_t>(key.J)) * 19349663) ^ (static_cast<size_t>(static_cast<uint32_t>(key.Portal)) * 83492791);
+		}
+	};
+
+	struct NodeRecord {
+		uint32_t Cost;
+		NodeKey Parent;
+		glm::ivec2 Tile;
+		bool Closed;
+	};
+
+	struct OpenNode {
+		uint32_t Estimate;      // cost so far + heuristic
+		uint32_t Cost;
+		NodeKey Key;
+
+		bool operator>(const OpenNode& other) const { return Estimate > other.Estimate; }
+	};
+
+	// Working storage for a search.  Each thread has its own, so that it is reused from one query to the next.
+	struct SearchContext {
+		std::vector<std::pair<std::pair<int, int>, Hazel::Ref<const ChunkNav>>> Chunks;  // chunks looked up by the current query
+		std::unordered_map<NodeKey, NodeRecord, NodeKeyHash> Records;
+		std::vector<OpenNode> Open;
+		std::vector<NodeKey> Route;
+		std::vector<uint16_t> StartField;
+		std::vector<uint16_t> GoalField;
+		NavScratch Scratch;
+	};
+
+	static constexpr int StartNode = -1;
+	static constexpr int GoalNode = -2;
+
+private:
+	bool Search(const glm::ivec2& start, const glm::ivec2& goal, std::vector<glm::ivec2>& path, SearchContext& context);
+
+	// Turns the route found by the abstract search into tiles
+	bool Refine(const glm::ivec2& start, std::vector<glm::ivec2>& path, SearchContext& context);
+
+	const ChunkNav* GetChunk(const int i, const int j, SearchContext& context);
+
+	void Worker();
+
+private:
+	NavLayout m_Layout;
+
+	HZ_PROFILE_LOCK(std::mutex, m_ChunkMutex, "Pathfinder Chunk Mutex");   // Synch access to m_Chunks
+	ChunkGrid<Hazel::Ref<const ChunkNav>> m_Chunks;
+
+	HZ_PROFILE_LOCK(std::mutex, m_QueueMutex, "Pathfinder Queue Mutex");   // Synch access to queries, results, and stats
+	std::condition_variable_any m_QueueCV;                                 // Notified when there are queries to process (or the workers should stop)
+	std::deque<PathRequest> m_Requests;
+	std::vector<PathResult> m_Results;
+	Stats m_Stats;
+	bool m_StopThreads = false;
+	std::vector<std::thread> m_Workers;
+
+	SearchContext m_SynchronousContext;                                    // for FindPath().  (so only one thread at a time may call FindPath())
+};
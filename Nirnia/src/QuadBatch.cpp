@@ -0,0 +1,225 @@
+#include "QuadBatch.h"
+
+#include <Hazel/Renderer/RenderCommand.h>
+
+#include <algorithm>
+#include <numeric>
+
+QuadBatch::~QuadBatch() {
+	Stop();
+}
+
+
+void QuadBatch::Init() {
+	HZ_PROFILE_FUNCTION();
+
+	m_Shader = Hazel::Shader::Create("assets/shaders/Texture.glsl");
+	int samplers[MaxTextureSlots];
+	std::iota(samplers, samplers + MaxTextureSlots, 0);
+	m_Shader->Bind();
+	m_Shader->SetIntArray("u_Textures", samplers, MaxTextureSlots);
+
+	m_VertexBuffer = Hazel::VertexBuffer::Create(MaxQuadsPerDraw * 4 * sizeof(QuadVertex));
+	m_VertexBuffer->SetLayout({
+		{Hazel::ShaderDataType::Float3, "a_Position"},
+		{Hazel::ShaderDataType::Float4, "a_Color"},
+		{Hazel::ShaderDataType::Float2, "a_TexCoord"},
+		{Hazel::ShaderDataType::Float, "a_TexIndex"},
+		{Hazel::ShaderDataType::Float, "a_TilingFactor"}
+	});
+	m_VertexArray = Hazel::VertexArray::Create();
+	m_VertexArray->AddVertexBuffer(m_VertexBuffer);
+
+	// Each quad is two triangles: corners 0, 1, 2 and 2, 3, 0
+	std::vector<uint32_t> indices(MaxQuadsPerDraw * 6);
+	for (uint32_t quad = 0; quad < MaxQuadsPerDraw; ++quad) {
+		const uint32_t vertex = quad * 4;
+		uint32_t* index = indices.data() + (quad * 6);
+		index[0] = vertex + 0;
+		index[1] = vertex + 1;
+		index[2] = vertex + 2;
+		index[3] = vertex + 2;
+		index[4] = vertex + 3;
+		index[5] = vertex + 0;
+	}
+	m_VertexArray->SetIndexBuffer(Hazel::IndexBuffer::Create(indices.data(), static_cast<uint32_t>(indices.size())));
+}
+
+
+void QuadBatch::Start(const uint32_t numThreads) {
+	Stop();
+	m_StopThreads = false;
+	for (uint32_t n = 0; n < numThreads; ++n) {
+		m_Workers.emplace_back(&QuadBatch::Worker, this, m_Frame);
+	}
+}
+
+
+void QuadBatch::Stop() {
+	{
+		std::lock_guard lock(m_Mutex);
+		HZ_PROFILE_LOCKMARKER(m_Mutex);
+		m_StopThreads = true;
+	}
+	m_BuildCV.notify_all();
+	for (std::thread& worker : m_Workers) {
+		worker.join();
+	}
+	m_Workers.clear();
+}
+
+
+QuadSprite QuadBatch::AddSprite(const Hazel::Ref<Hazel::SubTexture2D>& subTexture) {
+	const Hazel::Ref<Hazel::Texture2D> texture = subTexture->GetTexture();
+	size_t slot = std::find(m_Textures.begin(), m_Textures.end(), texture) - m_Textures.begin();
+	if (slot == m_Textures.size()) {
+		HZ_ASSERT(m_Textures.size() < MaxTextureSlots, "Too many textures for one quad batch");
+		m_Textures.push_back(texture);
+	}
+
+	QuadSprite sprite;
+	sprite.TextureIndex = static_cast<float>(slot);
+	const glm::vec2* texCoords = subTexture->GetTexCoords();
+	std::copy(texCoords, texCoords + 4, sprite.TexCoords);
+	return sprite;
+}
+
+
+void QuadBatch::Clear() {
+	m_Ranges.clear();
+	m_NumQuads = 0;
+}
+
+
+void QuadBatch::AddRange(const uint32_t maxQuads, Writer writer) {
+	m_Ranges.push_back({m_NumQuads, maxQuads, 0, 0, std::move(writer)});
+	m_NumQuads += maxQuads;
+}
+
+
+void QuadBatch::Build() {
+	HZ_PROFILE_FUNCTION();
+
+	m_Quads.resize(m_NumQuads);
+	Run(Pass::WriteQuads);
+
+	// Now that the counts are known, each range's vertices can go straight after those of the range before it
+	size_t numVertices = 0;
+	for (Range& range : m_Ranges) {
+		range.FirstVertex = numVertices;
+		numVertices += static_cast<size_t>(range.Count) * 4;
+	}
+	m_QuadCount = static_cast<uint32_t>(numVertices / 4);
+	m_Vertices.resize(numVertices);
+	Run(Pass::MakeVertices);
+}
+
+
+void QuadBatch::Submit(const Hazel::OrthographicCamera& camera) {
+	HZ_PROFILE_FUNCTION();
+
+	m_Stats = {};
+	m_Stats.QuadCount = m_QuadCount;
+
+	m_Shader->Bind();
+	m_Shader->SetMat4("u_ViewProjection", camera.GetViewProjectionMatrix());
+	m_VertexArray->Bind();
+	for (uint32_t first = 0; first < m_QuadCount; first += MaxQuadsPerDraw) {
+		const uint32_t count = std::min(m_QuadCount - first, MaxQuadsPerDraw);
+		m_VertexBuffer->SetData(m_Vertices.data() + (static_cast<size_t>(first) * 4), count * 4 * sizeof(QuadVertex));
+
+		// (every draw, as DrawIndexed() unbinds the active texture)
+		for (uint32_t slot = 0; slot < m_Textures.size(); ++slot) {
+			m_Textures[slot]->Bind(slot);
+		}
+		Hazel::RenderCommand::DrawIndexed(m_VertexArray, count * 6);
+		++m_Stats.DrawCalls;
+	}
+}
+
+
+void QuadBatch::Worker(uint64_t frame) {
+	while (true) {
+		Pass pass;
+		{
+			std::unique_lock lock(m_Mutex);
+			m_BuildCV.wait(lock, [&] { return m_StopThreads || (m_Frame != frame); });
+			HZ_PROFILE_LOCKMARKER(m_Mutex);
+			if (m_StopThreads) {
+				break;
+			}
+			frame = m_Frame;
+			pass = m_Pass;
+		}
+
+		RunRanges(pass);
+
+		{
+			std::lock_guard lock(m_Mutex);
+			HZ_PROFILE_LOCKMARKER(m_Mutex);
+			++m_WorkersDone;
+		}
+		m_DoneCV.notify_one();
+	}
+}
+
+
+void QuadBatch::Run(const Pass pass) {
+	m_NextRange = 0;
+
+	if (m_Workers.empty()) {
+		RunRanges(pass);
+		return;
+	}
+
+	{
+		std::lock_guard lock(m_Mutex);
+		HZ_PROFILE_LOCKMARKER(m_Mutex);
+		m_Pass = pass;
+		++m_Frame;
+		m_WorkersDone = 0;
+	}
+	m_BuildCV.notify_all();
+
+	RunRanges(pass);
+
+	// Every worker checks in for every pass, so that none can still be looking at the ranges once this returns
+	std::unique_lock lock(m_Mutex);
+	m_DoneCV.wait(lock, [&] { return m_WorkersDone == m_Workers.size(); });
+	HZ_PROFILE_LOCKMARKER(m_Mutex);
+}
+
+
+void QuadBatch::RunRanges(const Pass pass) {
+	HZ_PROFILE_FUNCTION();
+
+	const size_t numRanges = m_Ranges.size();
+	for (size_t index = m_NextRange++; index < numRanges; index = m_NextRange++) {
+		Range& range = m_Ranges[index];
+		if (pass == Pass::WriteQuads) {
+			range.Count = std::min(range.Write(m_Quads.data() + range.Begin), range.MaxQuads);
+		} else {
+			MakeVertices(range);
+		}
+	}
+}
+
+
+void QuadBatch::MakeVertices(const Range& range) {
+	// Corners in the order that Renderer2D::DrawQuad() makes them (and that sub-texture coordinates are given in)
+	static const glm::vec2 corners[4] = {{-0.5f, -0.5f}, {0.5f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f}};
+
+	const Quad* quads = m_Quads.data() + range.Begin;
+	QuadVertex* vertex = m_Vertices.data() + range.FirstVertex;
+	for (uint32_t n = 0; n < range.Count; ++n) {
+		const Quad& quad = quads[n];
+		for (int corner = 0; corner < 4; ++corner) {
+			vertex->Position = {quad.Position.x + (corners[corner].x * quad.Size.x), quad.Position.y + (corners[corner].y * quad.Size.y), quad.Position.z};
+			vertex->Color = {1.0f, 1.0f, 1.0f, 1.0f};
+			vertex->TexCoord = quad.Sprite->TexCoords[corner];
+			vertex->TexIndex = quad.Sprite->TextureIndex;
+			vertex->TilingFactor = 1.0f;
+			++vertex;
+		}
+	}
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "MemoryTracking.h"
+
+#include <Hazel/Core/Layer.h>
+#include <Hazel/Renderer/Buffer.h>
+#include <Hazel/Renderer/OrthographicCamera.h>
+#include <Hazel/Renderer/Shader.h>
+#include <Hazel/Renderer/SubTexture2D.h>
+#include <Hazel/Renderer/VertexArray.h>
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A sub-texture, as QuadBatch draws it: which of the batch's texture slots it is in, and where.
+// Made by QuadBatch::AddSprite().
+struct QuadSprite {
+	float TextureIndex;
+	glm::vec2 TexCoords[4];
+};
+
+
+// A textured quad (drawn the way Hazel::Renderer2D::DrawQuad() would draw it)
+struct Quad {
+	glm::vec3 Position;
+	glm::vec2 Size;
+	const QuadSprite* Sprite;
+};
+
+
+// Builds a frame's quads on several threads, and then draws them in a fixed order.
+//
+// Each frame, the caller adds ranges: a maximum number of quads, and a function that writes them.  Every range is
+// given its own region of the quad buffer up front, so the writers can run on any thread, in any order, without
+// synchronizing with each other.  Once they have all finished, each range's vertices are given a place in the vertex
+// buffer, straight after those of the range before it, and the ranges are turned into vertices (again in parallel).
+// The vertex buffer therefore holds the quads in the order in which the ranges were added, with no gaps, however the
+// work was spread over the threads, and Submit() only has to upload it and draw it.
+//
+// Renderer2D builds its vertices one DrawQuad() at a time, and its vertex buffer is private to it, so QuadBatch has
+// its own (using Renderer2D's shader and vertex layout).  Sprites must be registered with AddSprite() first, so that
+// making vertices does not have to look up (or reference count) textures.
+class QuadBatch
+{
+public:
+	// Writes at most the range's maximum number of quads, and returns how many it wrote
+	using Writer = std::function<uint32_t(Quad* quads)>;
+
+	static constexpr uint32_t MaxTextureSlots = 32;          // (u_Textures[] in the shader)
+	static constexpr uint32_t MaxQuadsPerDraw = 20000;
+
+	struct Stats {
+		uint32_t DrawCalls = 0;
+		uint32_t QuadCount = 0;
+	};
+
+public:
+	QuadBatch() = default;
+	~QuadBatch();
+
+	// Creates the shader and buffers that Submit() draws with.  Call on the render thread, before anything else.
+	void Init();
+
+	// Starts worker threads.  With no workers, Build() does all the work on the calling thread.
+	void Start(const uint32_t numThreads);
+	void Stop();
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+	// Registers a sub-texture to be drawn by quads.  Sprites can be cut from at most MaxTextureSlots textures.
+	QuadSprite AddSprite(const Hazel::Ref<Hazel::SubTexture2D>& subTexture);
+
+	// Removes all ranges
+	void Clear();
+
+	void AddRange(const uint32_t maxQuads, Writer writer);
+
+	// Runs the writers of all the ranges, and turns what they wrote into vertices (on the worker threads, and the
+	// calling thread), and returns when it is all done
+	void Build();
+
+	// Draws the vertices made by Build(), as seen by the given camera
+	void Submit(const Hazel::OrthographicCamera& camera);
+
+	uint32_t GetQuadCount() const { return m_QuadCount; }
+
+	// Of the most recent Submit()
+	const Stats& GetStats() const { return m_Stats; }
+
+private:
+	// Laid out as Renderer2D's vertices are (see assets/shaders/Texture.glsl)
+	struct QuadVertex {
+		glm::vec3 Position;
+		glm::vec4 Color;
+		glm::vec2 TexCoord;
+		float TexIndex;
+		float TilingFactor;
+	};
+
+	struct Range {
+		size_t Begin;
+		uint32_t MaxQuads;
+		uint32_t Count;
+		size_t FirstVertex;                                             // where the range's vertices go in m_Vertices
+		Writer Write;
+	};
+
+	enum class Pass {
+		WriteQuads,
+		MakeVertices
+	};
+
+private:
+	// frame is the most recent frame built before the worker was started (the worker waits for the next one)
+	void Worker(uint64_t frame);
+
+	// Runs the given pass over all the ranges, on the workers and the calling thread
+	void Run(const Pass pass);
+
+	// Claims ranges, and does the given pass for them, until there are none left
+	void RunRanges(const Pass pass);
+
+	void MakeVertices(const Range& range);
+
+private:
+	Hazel::Ref<Hazel::Shader> m_Shader;
+	Hazel::Ref<Hazel::VertexArray> m_VertexArray;
+	Hazel::Ref<Hazel::VertexBuffer> m_VertexBuffer;
+	std::vector<Hazel::Ref<Hazel::Texture2D>> m_Textures;               // by texture slot
+	Stats m_Stats;
+
+	std::vector<Quad, TaggedAllocator<Quad, MemoryTag::Renderer>> m_Quads;
+	std::vector<QuadVertex, TaggedAllocator<QuadVertex, MemoryTag::Renderer>> m_Vertices;
+	std::vector<Range, TaggedAllocator<Range, MemoryTag::Renderer>> m_Ranges;
+	size_t m_NumQuads = 0;                                              // total reserved by m_Ranges
+	uint32_t m_QuadCount = 0;                                           // total written by the most recent Build()
+	std::atomic<size_t> m_NextRange = 0;                                // next range to be claimed by a thread
+
+	HZ_PROFILE_LOCK(std::mutex, m_Mutex, "Quad Batch Mutex");           // Synch access to the frame counter and worker state
+	std::condition_variable_any m_BuildCV;                              // Notified when there is a new pass to run (or the workers should stop)
+	std::condition_variable_any m_DoneCV;                               // Notified when a worker has finished its part of a pass
+	uint64_t m_Frame = 0;                                               // bumped by every pass
+	Pass m_Pass = Pass::WriteQuads;
+	uint32_t m_WorkersDone = 0;                                         // workers that have finished with the current pass
+	bool m_StopThreads = false;
+	std::vector<std::thread> m_Workers;
+};
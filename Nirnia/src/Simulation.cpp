@@ -0,0 +1,197 @@
+#include "Simulation.h"
+
+#include "Navigation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+Simulation::Simulation(const uint32_t seed)
+: m_Random(seed)
+, m_Animation(static_cast<uint8_t>(PlayerState::NumStates), TicksPerAnimationFrame)
+{
+	for (PlayerState state : {PlayerState::Idle0, PlayerState::Idle1, PlayerState::Idle2, PlayerState::Idle3}) {
+		m_Animation.SetIdleTransitions(
+			static_cast<uint8_t>(state),
+			static_cast<uint8_t>(SetBlinkState(state)),
+			static_cast<uint8_t>(ClearBlinkState(state)),
+			static_cast<uint8_t>(SwapFootTapState(state))
+		);
+	}
+	m_Animation.AddActor(static_cast<uint8_t>(PlayerState::Idle0), 0, 0, seed);
+	SpawnActors(0, 0.0f);
+}
+
+
+void Simulation::SetAnimation(const PlayerState state, const std::vector<uint8_t>& frames) {
+	m_Animation.SetClip(static_cast<uint8_t>(state), frames);
+	m_Animation.SetActorClip(PlayerActor, m_Animation.GetActorClip(PlayerActor));
+	m_State.PlayerSprite = m_Animation.GetActorSprite(PlayerActor);
+}
+
+
+void Simulation::SetChunkLayout(const glm::vec2& chunkSize, const int radius) {
+	m_ChunkSize = chunkSize;
+	m_ChunkRadius = radius;
+
+	const std::vector<glm::vec2>& positions = *m_State.ActorPositions;
+	for (uint32_t actor = PlayerActor + 1; actor < positions.size(); ++actor) {
+		m_Animation.SetActorChunk(actor, GetChunkI(positions[actor].x), GetChunkJ(positions[actor].y));
+	}
+}
+
+
+void Simulation::SetCollision(std::function<bool(const glm::ivec2&)> isWalkable) {
+	m_IsWalkable = std::move(isWalkable);
+}
+
+
+void Simulation::SpawnActors(const uint32_t count, const float radius) {
+	HZ_PROFILE_FUNCTION();
+
+	m_Animation.RemoveActors(PlayerActor + 1);
+
+	Hazel::Ref<std::vector<glm::vec2>> positions = Hazel::CreateRef<std::vector<glm::vec2>>();
+	positions->reserve(count + 1);
+	positions->push_back(m_State.PlayerPos); // the player's entry is never used.  It's just there so that actor ids can index the vector
+	for (uint32_t n = 0; n < count; ++n) {
+		glm::vec2 position = {m_Random.Uniform(-radius, radius), m_Random.Uniform(-radius, radius)};
+		uint8_t clip = static_cast<uint8_t>(m_Random.UniformInt(static_cast<int>(PlayerState::Idle0), static_cast<int>(PlayerState::Idle3)));
+		positions->push_back(position);
+		m_Animation.AddActor(clip, GetChunkI(position.x), GetChunkJ(position.y), n + 1);
+	}
+	m_State.ActorPositions = positions;
+	PublishSprites();
+}
+
+
+void Simulation::Step(const SimulationInput& input) {
+	HZ_PROFILE_FUNCTION();
+
+	++m_State.Tick;
+	UpdatePlayer(input);
+	Animate();
+}
+
+
+void Simulation::UpdatePlayer(const SimulationInput& input) {
+	constexpr float distance = PlayerSpeed * TickDuration;
+
+	PlayerState newState = PlayerState::Idle0;
+	glm::vec2 move = {0.0f, 0.0f};
+	if (input.IsPressed(InputKey::Left)) {
+		move.x = -distance;
+		m_State.PlayerSize = {-1, 1};
+		newState = PlayerState::WalkLeft;
+	} else if (input.IsPressed(InputKey::Right)) {
+		move.x = distance;
+		m_State.PlayerSize = {1, 1};
+		newState = PlayerState::WalkRight;
+	}
+
+	if (input.IsPressed(InputKey::Up)) {
+		move.y = distance;
+		newState = PlayerState::WalkUp;
+	} else if (input.IsPressed(InputKey::Down)) {
+		move.y = -distance;
+		newState = PlayerState::WalkDown;
+	}
+
+	// Each axis is moved separately, so that the player slides along obstacles rather than sticking to them
+	glm::vec2 position = {m_State.PlayerPos.x + move.x, m_State.PlayerPos.y};
+	if (CanMove(m_State.PlayerPos, position)) {
+		m_State.PlayerPos = position;
+	}
+	position = {m_State.PlayerPos.x, m_State.PlayerPos.y + move.y};
+	if (CanMove(m_State.PlayerPos, position)) {
+		m_State.PlayerPos = position;
+	}
+
+	PlayerState state = static_cast<PlayerState>(m_Animation.GetActorClip(PlayerActor));
+	if (newState != state) {
+		if (!IsIdle(newState) || !IsIdle(state)) {
+			m_Animation.SetActorClip(PlayerActor, static_cast<uint8_t>(newState));
+		}
+	}
+}
+
+
+bool Simulation::CanMove(const glm::vec2& from, const glm::vec2& to) const {
+	if (!m_IsWalkable) {
+		return true;
+	}
+	// A player that is already somewhere they shouldn't be (e.g. started out in water) is allowed to move anywhere,
+	// so that they can never get stuck
+	glm::ivec2 tile = GetTile({to.x, to.y - PlayerFootOffset});
+	return m_IsWalkable(tile) || !m_IsWalkable(GetTile({from.x, from.y - PlayerFootOffset}));
+}
+
+
+void Simulation::Animate() {
+	// Only actors in chunks around the player are animated
+	int i = GetChunkI(m_State.PlayerPos.x);
+	int j = GetChunkJ(m_State.PlayerPos.y);
+	m_Animation.SetActorChunk(PlayerActor, i, j);
+
+	auto start = std::chrono::steady_clock::now();
+	m_Animation.Update(i - m_ChunkRadius, j - m_ChunkRadius, i + m_ChunkRadius, j + m_ChunkRadius);
+	m_Stats.AnimationTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	m_State.State = static_cast<PlayerState>(m_Animation.GetActorClip(PlayerActor));
+	m_State.PlayerSprite = m_Animation.GetActorSprite(PlayerActor);
+	PublishSprites();
+}
+
+
+void Simulation::PublishSprites() {
+	HZ_PROFILE_FUNCTION();
+
+	// A buffer that only m_SpriteBuffers refers to has been dropped by every state it was published in, and nothing
+	// can pick it up again, so it is free to overwrite.  (the fence pairs with the release of the last reference to
+	// it, which may have been on another thread)
+	auto buffer = std::find_if(m_SpriteBuffers.begin(), m_SpriteBuffers.end(), [](const Hazel::Ref<std::vector<uint8_t>>& buffer) { return buffer.use_count() == 1; });
+	if (buffer == m_SpriteBuffers.end()) {
+		buffer = m_SpriteBuffers.insert(m_SpriteBuffers.end(), Hazel::CreateRef<std::vector<uint8_t>>());
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	const std::vector<uint8_t>& sprites = m_Animation.GetSprites();
+	(*buffer)->assign(sprites.begin(), sprites.end());
+	m_State.ActorSprites = *buffer;
+}
+
+
+// (position x is in tile floor(x) + 1, see GetTile())
+int Simulation::GetChunkI(const float x) const {
+	return static_cast<int>(std::floor((x + 1.0f) / m_ChunkSize.x));
+}
+
+
+int Simulation::GetChunkJ(const float y) const {
+	return static_cast<int>(std::floor((y + 1.0f) / m_ChunkSize.y));
+}
+
+
+void SimulationStateBuffer::Publish(const SimulationState& previous, const SimulationState& current, const SimulationStats& stats) {
+	// Only the publishing thread ever changes m_Front, so it is safe to read it here without the lock
+	Entry& back = m_Entries[1 - m_Front];
+	back.Previous = previous;
+	back.Current = current;
+	back.Stats = stats;
+	back.PublishTime = Clock::now();
+
+	std::lock_guard lock(m_Mutex);
+	HZ_PROFILE_LOCKMARKER(m_Mutex);
+	m_Front = 1 - m_Front;
+}
+
+
+void SimulationStateBuffer::Read(SimulationState& previous, SimulationState& current, SimulationStats& stats, Clock::time_point& publishTime) {
+	std::lock_guard lock(m_Mutex);
+	HZ_PROFILE_LOCKMARKER(m_Mutex);
+	const Entry& front = m_Entries[m_Front];
+	previous = front.Previous;
+	current = front.Current;
+	stats = front.Stats;
+	publishTime = front.PublishTime;
+}
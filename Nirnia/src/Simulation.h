@@ -0,0 +1,150 @@
+#pragma once
+
+#include "AnimationSystem.h"
+#include "PlayerState.h"
+#include "Random.h"
+
+#include <Hazel/Core/Layer.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Keys that the simulation responds to
+enum class InputKey : uint8_t {
+	Left  = 1 << 0,
+	Right = 1 << 1,
+	Up    = 1 << 2,
+	Down  = 1 << 3
+};
+
+
+// Input for one simulation tick.
+// Input is sampled by the render thread (where the window lives) and handed to the simulation, so that the
+// simulation itself never touches the window system.
+struct SimulationInput {
+	uint8_t Keys = 0;
+
+	bool IsPressed(const InputKey key) const { return (Keys & static_cast<uint8_t>(key)) != 0; }
+	void Press(const InputKey key) { Keys |= static_cast<uint8_t>(key); }
+};
+
+
+// Everything the renderer needs to know about the simulation
+struct SimulationState {
+	uint64_t Tick = 0;
+	glm::vec2 PlayerPos = {0.0f, 0.0f};
+	glm::vec2 PlayerSize = {1.0f, 1.0f};  // x is -ve when facing left
+	PlayerState State = PlayerState::Idle0;
+	uint8_t PlayerSprite = 0;
+
+	Hazel::Ref<const std::vector<glm::vec2>> ActorPositions;  // indexed by actor id.  Never modified once published (spawning actors replaces the whole vector)
+	Hazel::Ref<const std::vector<uint8_t>> ActorSprites;       // indexed by actor id.  Never modified once published (each tick publishes a new one)
+};
+
+
+// Timings of the simulation.  (kept apart from the state, which must depend only on the seed and input)
+struct SimulationStats {
+	float AnimationTime = 0.0f;           // milliseconds taken by the most recent animation update
+};
+
+
+// Fixed timestep game simulation.
+// The simulation only ever advances in whole ticks, and depends only on its seed and the input for each tick.
+// This makes it reproducible regardless of how fast (or on which thread) it is driven.
+class Simulation
+{
+public:
+	static constexpr uint32_t TickRate = 60;                          // ticks per second
+	static constexpr float TickDuration = 1.0f / TickRate;            // seconds
+	static constexpr uint32_t TicksPerAnimationFrame = TickRate / 10; // animations run at 10 frames per second
+	static constexpr uint32_t PlayerActor = 0;                        // actor id of the player
+	static constexpr float PlayerSpeed = 1.5f;                        // units per second
+	static constexpr float PlayerFootOffset = 0.4f;                   // player's feet are this far below their position
+
+public:
+	Simulation(const uint32_t seed);
+
+	// Sets the sprites making up the animation for given player state.
+	// All actors (not just the player) share the player's animations.
+	void SetAnimation(const PlayerState state, const std::vector<uint8_t>& frames);
+
+	// Sets how the world is divided up into chunks: chunk (i, j) is tiles [i * size.x, (i + 1) * size.x) x
+	// [j * size.y, (j + 1) * size.y).  Only actors within radius chunks of the player are animated.
+	// Actors that are not animated do not advance, so for the simulation to be reproducible the layout must not depend
+	// on anything outside of it (e.g. the size of the view).
+	void SetChunkLayout(const glm::vec2& chunkSize, const int radius);
+
+	// Sets the test for whether the player can walk on a tile (pass an empty function to turn collision off).
+	// The test must be deterministic (e.g. worked out from the terrain, not from whatever has been streamed in so far)
+	// for the simulation to be reproducible.
+	void SetCollision(std::function<bool(const glm::ivec2&)> isWalkable);
+
+	// Replaces all actors (other than the player) with count new ones, scattered randomly within radius of the origin
+	void SpawnActors(const uint32_t count, const float radius);
+
+	// Advances the simulation by one tick
+	void Step(const SimulationInput& input);
+
+	const SimulationState& GetState() const { return m_State; }
+	const SimulationStats& GetStats() const { return m_Stats; }
+
+private:
+	void UpdatePlayer(const SimulationInput& input);
+	void Animate();
+
+	// Publishes a copy of the animation system's sprites as m_State.ActorSprites
+	void PublishSprites();
+
+	// Returns true if the player can move from one position to another
+	bool CanMove(const glm::vec2& from, const glm::vec2& to) const;
+
+	int GetChunkI(const float x) const;
+	int GetChunkJ(const float y) const;
+
+private:
+	SimulationState m_State;
+	SimulationStats m_Stats;
+	Random m_Random;
+	AnimationSystem m_Animation;
+	std::vector<Hazel::Ref<std::vector<uint8_t>>> m_SpriteBuffers;  // every sprite vector published so far.  Those no longer referenced by any state are reused
+
+	glm::vec2 m_ChunkSize = {1.0f, 1.0f};
+	int m_ChunkRadius = 1;
+
+	std::function<bool(const glm::ivec2&)> m_IsWalkable;  // empty => no collision
+};
+
+
+// Double buffered hand-off of simulation state from the simulation thread to the render thread.
+// The simulation thread fills in the back buffer without holding any lock, and then flips the buffers.
+// The render thread only ever reads the front buffer.
+class SimulationStateBuffer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Publishes the state before and after the most recent tick (the render thread interpolates between them), and
+	// the simulation's stats
+	void Publish(const SimulationState& previous, const SimulationState& current, const SimulationStats& stats);
+
+	// Reads the most recently published states and stats, and the time at which they were published
+	void Read(SimulationState& previous, SimulationState& current, SimulationStats& stats, Clock::time_point& publishTime);
+
+private:
+	struct Entry {
+		SimulationState Previous;
+		SimulationState Current;
+		SimulationStats Stats;
+		Clock::time_point PublishTime;
+	};
+
+	std::array<Entry, 2> m_Entries;
+	uint32_t m_Front = 0;
+	HZ_PROFILE_LOCK(std::mutex, m_Mutex, "Simulation State Mutex");
+};
@@ -0,0 +1,768 @@
+#include "TerrainGraph.h"
+
+#include <Hazel/Core/Layer.h>
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+namespace {
+
+	template<typename T>
+	struct Named {
+		const char* Name;
+		T Value;
+	};
+
+	constexpr Named<FastNoise::NoiseType> NoiseTypes[] = {
+		{"Value", FastNoise::Value},
+		{"ValueFractal", FastNoise::ValueFractal},
+		{"Perlin", FastNoise::Perlin},
+		{"PerlinFractal", FastNoise::PerlinFractal},
+		{"Simplex", FastNoise::Simplex},
+		{"SimplexFractal", FastNoise::SimplexFractal},
+		{"Cellular", FastNoise::Cellular},
+		{"WhiteNoise", FastNoise::WhiteNoise},
+		{"Cubic", FastNoise::Cubic},
+		{"CubicFractal", FastNoise::CubicFractal}
+	};
+
+	constexpr Named<FastNoise::Interp> Interps[] = {
+		{"Linear", FastNoise::Linear},
+		{"Hermite", FastNoise::Hermite},
+		{"Quintic", FastNoise::Quintic}
+	};
+
+	constexpr Named<FastNoise::FractalType> FractalTypes[] = {
+		{"FBM", FastNoise::FBM},
+		{"Billow", FastNoise::Billow},
+		{"RigidMulti", FastNoise::RigidMulti}
+	};
+
+	constexpr Named<TreeKind> TreeKinds[] = {
+		{"LargeTree", TreeKind::LargeTree},
+		{"SmallTree", TreeKind::SmallTree},
+		{"LoneShrub", TreeKind::LoneShrub},
+		{"Shrub", TreeKind::Shrub},
+		{"ClusteredShrub", TreeKind::ClusteredShrub}
+	};
+
+
+	template<typename T, size_t N>
+	bool ParseNamed(const std::string& text, const Named<T>(&names)[N], T& value) {
+		for (const Named<T>& named : names) {
+			if (text == named.Name) {
+				value = named.Value;
+				return true;
+			}
+		}
+		return false;
+	}
+
+
+	template<typename T, size_t N>
+	const char* GetName(const T value, const Named<T>(&names)[N]) {
+		for (const Named<T>& named : names) {
+			if (value == named.Value) {
+				return named.Name;
+			}
+		}
+		return "?";
+	}
+
+
+	// Shortest text that parses back to exactly the same value
+	std::string FormatFloat(const float value) {
+		char text[32];
+		return std::string(text, std::to_chars(text, text + sizeof(text), value).ptr);
+	}
+
+
+	bool ParseFloat(const std::string& text, float& value) {
+		std::istringstream stream(text);
+		return (stream >> value) && stream.eof();
+	}
+
+
+	bool ParseInt(const std::string& text, int& value) {
+		std::istringstream stream(text);
+		return (stream >> value) && stream.eof();
+	}
+
+
+	bool ParseNoiseSetting(const std::string& setting, TerrainNoise& noise) {
+		size_t equals = setting.find('=');
+		if (equals == std::string::npos) {
+			return false;
+		}
+		std::string key = setting.substr(0, equals);
+		std::string value = setting.substr(equals + 1);
+		if (key == "seed") return ParseInt(value, noise.Seed);
+		if (key == "type") return ParseNamed(value, NoiseTypes, noise.Type);
+		if (key == "frequency") return ParseFloat(value, noise.Frequency);
+		if (key == "interp") return ParseNamed(value, Interps, noise.Interp);
+		if (key == "octaves") return ParseInt(value, noise.Octaves);
+		if (key == "lacunarity") return ParseFloat(value, noise.Lacunarity);
+		if (key == "gain") return ParseFloat(value, noise.Gain);
+		if (key == "fractal") return ParseNamed(value, FractalTypes, noise.Fractal);
+		return false;
+	}
+
+
+	int SelectBranch(const float selector, const int numBranches) {
+		return std::clamp(static_cast<int>(selector), 0, numBranches - 1);
+	}
+
+
+	// Key that is the same for two nodes if and only if they compute the same thing.  (inputs are already merged)
+	std::string GetNodeKey(const TerrainNode& node, const std::vector<int>& inputs) {
+		std::ostringstream key;
+		key << std::hexfloat << static_cast<int>(node.Op);
+		if (node.Op == TerrainOp::Noise) {
+			const TerrainNoise& noise = node.Noise;
+			key << ' ' << noise.Seed << ' ' << static_cast<int>(noise.Type) << ' ' << noise.Frequency << ' ' << static_cast<int>(noise.Interp);
+			key << ' ' << noise.Octaves << ' ' << noise.Lacunarity << ' ' << noise.Gain << ' ' << static_cast<int>(noise.Fractal);
+		}
+		key << (node.Strict ? " >" : " >=");
+		for (float value : node.Values) {
+			key << ' ' << value;
+		}
+		key << " |";
+		for (int input : inputs) {
+			key << ' ' << input;
+		}
+		return key.str();
+	}
+
+}
+
+
+bool TerrainNoise::operator==(const TerrainNoise& other) const {
+	return (Seed == other.Seed) && (Type == other.Type) && (Frequency == other.Frequency) && (Interp == other.Interp) &&
+		(Octaves == other.Octaves) && (Lacunarity == other.Lacunarity) && (Gain == other.Gain) && (Fractal == other.Fractal);
+}
+
+
+bool TreeScatterRule::operator==(const TreeScatterRule& other) const {
+	return (Value == other.Value) && (Kind == other.Kind) && (Probability == other.Probability) &&
+		(OffsetMin == other.OffsetMin) && (OffsetMax == other.OffsetMax) && (ScaleMin == other.ScaleMin) && (ScaleMax == other.ScaleMax) &&
+		(ClusterKind == other.ClusterKind) && (ClusterProbability == other.ClusterProbability);
+}
+
+
+int TerrainGraph::FindNode(const std::string& name) const {
+	for (size_t node = 0; node < Nodes.size(); ++node) {
+		if (Nodes[node].Name == name) {
+			return static_cast<int>(node);
+		}
+	}
+	return -1;
+}
+
+
+int TerrainGraph::FindOutput(const std::string& name) const {
+	for (size_t output = 0; output < Outputs.size(); ++output) {
+		if (Outputs[output].first == name) {
+			return static_cast<int>(output);
+		}
+	}
+	return -1;
+}
+
+
+bool TerrainGraph::Load(const std::string& path, std::string& error) {
+	std::ifstream file(path);
+	if (!file) {
+		error = "could not open '" + path + "'";
+		return false;
+	}
+	if (!Parse(file, error)) {
+		error = path + ": " + error;
+		return false;
+	}
+	return true;
+}
+
+
+bool TerrainGraph::Parse(std::istream& stream, std::string& error) {
+	Nodes.clear();
+	Outputs.clear();
+	TreeRules.clear();
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(stream, line); ++lineNumber) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream lineStream(line);
+		std::vector<std::string> words;
+		for (std::string word; lineStream >> word;) {
+			words.push_back(word);
+		}
+		if (words.empty()) {
+			continue;
+		}
+
+		auto fail = [&](const std::string& message) {
+			error = "line " + std::to_string(lineNumber) + ": " + message;
+			return false;
+		};
+
+		auto input = [&](const std::string& name, int& node) {
+			node = FindNode(name);
+			return node >= 0;
+		};
+
+		const std::string& keyword = words[0];
+		if (keyword == "output") {
+			int node;
+			if (words.size() != 3) {
+				return fail("expected: output <name> <node>");
+			}
+			if (!input(words[2], node)) {
+				return fail("unknown node '" + words[2] + "'");
+			}
+			if (FindOutput(words[1]) >= 0) {
+				return fail("output '" + words[1] + "' is already defined");
+			}
+			Outputs.emplace_back(words[1], node);
+			continue;
+		}
+
+		if (keyword == "scatter") {
+			TreeScatterRule rule;
+			if ((words.size() != 8) && (words.size() != 10)) {
+				return fail("expected: scatter <value> <kind> <probability> <offset min> <offset max> <scale min> <scale max> [<cluster kind> <cluster probability>]");
+			}
+			if (!ParseInt(words[1], rule.Value) || !ParseNamed(words[2], TreeKinds, rule.Kind) || !ParseFloat(words[3], rule.Probability) ||
+				!ParseFloat(words[4], rule.OffsetMin) || !ParseFloat(words[5], rule.OffsetMax) || !ParseFloat(words[6], rule.ScaleMin) || !ParseFloat(words[7], rule.ScaleMax)) {
+				return fail("invalid scatter rule");
+			}
+			if ((words.size() == 10) && (!ParseNamed(words[8], TreeKinds, rule.ClusterKind) || !ParseFloat(words[9], rule.ClusterProbability))) {
+				return fail("invalid cluster");
+			}
+			if ((rule.Value < 0) || (rule.Value > TreeScatterRule::MaxValue)) {
+				return fail("scatter value must be within [0, " + std::to_string(TreeScatterRule::MaxValue) + "]");
+			}
+			if ((rule.OffsetMin < 0.0f) || (rule.OffsetMax > 1.0f) || (rule.OffsetMin > rule.OffsetMax) || (rule.ScaleMin <= 0.0f) || (rule.ScaleMax >= 4.0f) || (rule.ScaleMin > rule.ScaleMax)) {
+				return fail("offsets must be within [0, 1], and scales within (0, 4)");
+			}
+			TreeRules.push_back(rule);
+			continue;
+		}
+
+		if (words.size() < 2) {
+			return fail("expected a node name");
+		}
+		if (FindNode(words[1]) >= 0) {
+			return fail("node '" + words[1] + "' is already defined");
+		}
+
+		TerrainNode node;
+		node.Name = words[1];
+		if (keyword == "noise") {
+			node.Op = TerrainOp::Noise;
+			for (size_t word = 2; word < words.size(); ++word) {
+				if (!ParseNoiseSetting(words[word], node.Noise)) {
+					return fail("invalid noise setting '" + words[word] + "'");
+				}
+			}
+		} else if (keyword == "constant") {
+			node.Op = TerrainOp::Constant;
+			node.Values.resize(1);
+			if ((words.size() != 3) || !ParseFloat(words[2], node.Values[0])) {
+				return fail("expected: constant <name> <value>");
+			}
+		} else if (keyword == "remap") {
+			node.Op = TerrainOp::Remap;
+			node.Inputs.resize(1);
+			node.Values.resize(2);
+			if ((words.size() != 5) || !input(words[2], node.Inputs[0]) || !ParseFloat(words[3], node.Values[0]) || !ParseFloat(words[4], node.Values[1])) {
+				return fail("expected: remap <name> <input> <scale> <offset>");
+			}
+		} else if (keyword == "threshold") {
+			node.Op = TerrainOp::Threshold;
+			node.Inputs.resize(1);
+			if ((words.size() < 5) || !input(words[2], node.Inputs[0]) || ((words[3] != ">") && (words[3] != ">="))) {
+				return fail("expected: threshold <name> <input> <'>'|'>='> <t0> [<t1> ...]");
+			}
+			node.Strict = words[3] == ">";
+			node.Values.resize(words.size() - 4);
+			for (size_t word = 4; word < words.size(); ++word) {
+				if (!ParseFloat(words[word], node.Values[word - 4]) || ((word > 4) && (node.Values[word - 4] < node.Values[word - 5]))) {
+					return fail("thresholds must be numbers, in ascending order");
+				}
+			}
+		} else if (keyword == "select") {
+			node.Op = TerrainOp::Select;
+			if (words.size() < 4) {
+				return fail("expected: select <name> <selector> <input0> [<input1> ...]");
+			}
+			node.Inputs.resize(words.size() - 2);
+			for (size_t word = 2; word < words.size(); ++word) {
+				if (!input(words[word], node.Inputs[word - 2])) {
+					return fail("unknown node '" + words[word] + "'");
+				}
+			}
+		} else if (keyword == "tile") {
+			node.Op = TerrainOp::Tile;
+			node.Inputs.resize(1);
+			if ((words.size() != 3) || !input(words[2], node.Inputs[0])) {
+				return fail("expected: tile <name> <input>");
+			}
+		} else {
+			return fail("unknown keyword '" + keyword + "'");
+		}
+		Nodes.push_back(std::move(node));
+	}
+
+	if (Outputs.empty()) {
+		error = "no outputs";
+		return false;
+	}
+	return true;
+}
+
+
+bool TerrainGraph::Save(const std::string& path, std::string& error) const {
+	std::ofstream file(path);
+	if (file) {
+		Write(file);
+	}
+	if (!file) {
+		error = "could not write '" + path + "'";
+		return false;
+	}
+	return true;
+}
+
+
+void TerrainGraph::Write(std::ostream& stream) const {
+	static const char* keywords[] = {"noise", "constant", "remap", "threshold", "select", "tile"};
+
+	for (const TerrainNode& node : Nodes) {
+		stream << keywords[static_cast<int>(node.Op)] << ' ' << node.Name;
+		if (node.Op == TerrainOp::Noise) {
+			const TerrainNoise& noise = node.Noise;
+			stream << " seed=" << noise.Seed << " type=" << GetName(noise.Type, NoiseTypes) << " frequency=" << FormatFloat(noise.Frequency);
+			stream << " interp=" << GetName(noise.Interp, Interps) << " octaves=" << noise.Octaves << " lacunarity=" << FormatFloat(noise.Lacunarity);
+			stream << " gain=" << FormatFloat(noise.Gain) << " fractal=" << GetName(noise.Fractal, FractalTypes);
+		}
+		for (size_t input = 0; input < node.Inputs.size(); ++input) {
+			stream << ' ' << Nodes[node.Inputs[input]].Name;
+		}
+		if (node.Op == TerrainOp::Threshold) {
+			stream << (node.Strict ? " >" : " >=");
+		}
+		for (float value : node.Values) {
+			stream << ' ' << FormatFloat(value);
+		}
+		stream << '\n';
+	}
+
+	stream << '\n';
+	for (const auto& [name, node] : Outputs) {
+		stream << "output " << name << ' ' << Nodes[node].Name << '\n';
+	}
+
+	if (!TreeRules.empty()) {
+		stream << '\n';
+	}
+	for (const TreeScatterRule& rule : TreeRules) {
+		stream << "scatter " << rule.Value << ' ' << GetName(rule.Kind, TreeKinds) << ' ' << FormatFloat(rule.Probability);
+		stream << ' ' << FormatFloat(rule.OffsetMin) << ' ' << FormatFloat(rule.OffsetMax) << ' ' << FormatFloat(rule.ScaleMin) << ' ' << FormatFloat(rule.ScaleMax);
+		if (rule.ClusterProbability > 0.0f) {
+			stream << ' ' << GetName(rule.ClusterKind, TreeKinds) << ' ' << FormatFloat(rule.ClusterProbability);
+		}
+		stream << '\n';
+	}
+}
+
+
+bool TerrainPlan::Compile(const TerrainGraph& graph, std::string& error, const bool shareBuffers) {
+	HZ_PROFILE_FUNCTION();
+
+	m_Steps.clear();
+	m_Outputs.clear();
+	m_OutputSteps.clear();
+	m_NumBuffers = 0;
+
+	const int numNodes = static_cast<int>(graph.Nodes.size());
+	if (graph.Outputs.empty()) {
+		error = "no outputs";
+		return false;
+	}
+	for (const TerrainNode& node : graph.Nodes) {
+		if ((node.Op == TerrainOp::Threshold) && !std::is_sorted(node.Values.begin(), node.Values.end())) {
+			error = "thresholds of '" + node.Name + "' are not in ascending order";
+			return false;
+		}
+	}
+
+	// Merge identical nodes.  Nodes only refer to earlier nodes, so one pass in order does it.
+	// Node n is computed by node merged[n], which is transformed by scale[n] and offset[n] (once remaps are folded).
+	std::vector<int> merged(numNodes);
+	std::vector<std::vector<int>> inputs(numNodes);
+	std::map<std::string, int> keys;
+	for (int node = 0; node < numNodes; ++node) {
+		for (int input : graph.Nodes[node].Inputs) {
+			inputs[node].push_back(merged[input]);
+		}
+		merged[node] = keys.emplace(GetNodeKey(graph.Nodes[node], inputs[node]), node).first->second;
+	}
+
+	// Drop whatever does not contribute to an output
+	std::vector<bool> isOutput(numNodes, false);
+	std::vector<bool> isLive(numNodes, false);
+	for (const auto& [name, node] : graph.Outputs) {
+		isOutput[merged[node]] = true;
+		isLive[merged[node]] = true;
+	}
+	std::vector<int> consumers(numNodes, 0);
+	for (int node = numNodes - 1; node >= 0; --node) {
+		if (isLive[node]) {
+			for (int input : inputs[node]) {
+				isLive[input] = true;
+				++consumers[input];
+			}
+		}
+	}
+
+	// Fold remaps into their input, where nothing else uses the input's value
+	std::vector<float> scale(numNodes, 1.0f);
+	std::vector<float> offset(numNodes, 0.0f);
+	for (int node = 0; node < numNodes; ++node) {
+		if (!isLive[node] || (graph.Nodes[node].Op != TerrainOp::Remap)) {
+			continue;
+		}
+		int input = inputs[node][0];
+		if ((consumers[input] == 1) && !isOutput[input]) {
+			const float remapScale = graph.Nodes[node].Values[0];
+			const float remapOffset = graph.Nodes[node].Values[1];
+			scale[input] *= remapScale;
+			offset[input] = (offset[input] * remapScale) + remapOffset;
+			isLive[node] = false;
+			isOutput[input] = isOutput[node];
+			consumers[input] = consumers[node];
+			for (int other = node + 1; other < numNodes; ++other) {
+				std::replace(inputs[other].begin(), inputs[other].end(), node, input);
+			}
+			for (int other = node; other < numNodes; ++other) {
+				if (merged[other] == node) {
+					merged[other] = input;
+				}
+			}
+		}
+	}
+
+	std::vector<int> live;
+	for (int node = 0; node < numNodes; ++node) {
+		if (isLive[node]) {
+			live.push_back(node);
+		}
+	}
+
+	// dependsOn[a][b] => a (transitively) uses the value of b
+	std::vector<std::vector<bool>> dependsOn(numNodes, std::vector<bool>(numNodes, false));
+	for (int node : live) {
+		for (int input : inputs[node]) {
+			dependsOn[node][input] = true;
+			for (int other = 0; other < input; ++other) {
+				if (dependsOn[input][other]) {
+					dependsOn[node][other] = true;
+				}
+			}
+		}
+	}
+
+	// Work out which tiles each node is needed for, working back from the outputs.  A node that is a branch of a
+	// select is only needed where the selector picks it, and a node that only feeds other nodes is only needed where
+	// they are.  (guard = set of (selector, branch, number of branches), any of which means the node is needed.
+	// Empty => everywhere)
+	using Guard = std::set<std::tuple<int, int, int>>;
+	std::vector<Guard> guards(numNodes);
+	std::vector<bool> always(numNodes, false);
+	for (auto it = live.rbegin(); it != live.rend(); ++it) {
+		const int node = *it;
+		Guard& guard = guards[node];
+		bool nodeAlways = isOutput[node];
+		for (int consumer : live) {
+			if (nodeAlways) {
+				break;
+			}
+			if (consumer <= node) {
+				continue;
+			}
+			for (size_t position = 0; position < inputs[consumer].size(); ++position) {
+				if (inputs[consumer][position] != node) {
+					continue;
+				}
+				const TerrainOp op = graph.Nodes[consumer].Op;
+				if ((op == TerrainOp::Select) && (position > 0)) {
+					guard.emplace(inputs[consumer][0], static_cast<int>(position) - 1, static_cast<int>(inputs[consumer].size()) - 1);
+				} else if ((op == TerrainOp::Tile) || always[consumer]) {
+					nodeAlways = true;          // (tile needs its input at its neighbours too)
+				} else {
+					guard.insert(guards[consumer].begin(), guards[consumer].end());
+				}
+			}
+		}
+		for (const auto& [selector, branch, numBranches] : guard) {
+			if ((selector == node) || dependsOn[selector][node]) {
+				nodeAlways = true;              // selector can't be known before the node has been evaluated everywhere
+			}
+		}
+		if (nodeAlways) {
+			guard.clear();
+		}
+		always[node] = nodeAlways;
+	}
+
+	// Order the steps so that each comes after its inputs, and after the selectors in its guard.  (the latter can,
+	// rarely, make a cycle, in which case guards are given up on)
+	std::vector<int> order;
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		order.clear();
+		std::vector<bool> done(numNodes, false);
+		while (order.size() < live.size()) {
+			int next = -1;
+			for (int node : live) {
+				if (done[node]) {
+					continue;
+				}
+				bool ready = std::all_of(inputs[node].begin(), inputs[node].end(), [&](int input) { return done[input]; });
+				for (const auto& [selector, branch, numBranches] : guards[node]) {
+					ready = ready && done[selector];
+				}
+				if (ready) {
+					next = node;
+					break;
+				}
+			}
+			if (next < 0) {
+				break;
+			}
+			done[next] = true;
+			order.push_back(next);
+		}
+		if (order.size() == live.size()) {
+			break;
+		}
+		for (int node : live) {
+			guards[node].clear();
+		}
+	}
+
+	// Assign buffers, reusing those whose values are no longer needed (if sharing is allowed)
+	std::vector<size_t> lastUse(numNodes, 0);
+	for (size_t step = 0; step < order.size(); ++step) {
+		const int node = order[step];
+		for (int input : inputs[node]) {
+			lastUse[input] = step;
+		}
+		for (const auto& [selector, branch, numBranches] : guards[node]) {
+			lastUse[selector] = step;
+		}
+		if (isOutput[node]) {
+			lastUse[node] = order.size();
+		}
+	}
+	std::vector<uint32_t> buffer(numNodes, 0);
+	std::vector<size_t> stepOf(numNodes, 0);
+	std::vector<uint32_t> freeBuffers;
+	for (size_t step = 0; step < order.size(); ++step) {
+		const int node = order[step];
+		const TerrainNode& definition = graph.Nodes[node];
+		stepOf[node] = step;
+		if (freeBuffers.empty()) {
+			buffer[node] = m_NumBuffers++;
+		} else {
+			buffer[node] = freeBuffers.back();
+			freeBuffers.pop_back();
+		}
+
+		Step& plan = m_Steps.emplace_back();
+		plan.Op = definition.Op;
+		plan.Output = buffer[node];
+		for (int input : inputs[node]) {
+			plan.Inputs.push_back(buffer[input]);
+		}
+		plan.Values = definition.Values;
+		plan.Strict = definition.Strict;
+		plan.Scale = scale[node];
+		plan.Offset = offset[node];
+		if (definition.Op == TerrainOp::Remap) {
+			plan.Scale *= definition.Values[0];
+			plan.Offset += definition.Values[1] * scale[node];
+		}
+		for (const auto& [selector, branch, numBranches] : guards[node]) {
+			plan.Guard.push_back({buffer[selector], branch, numBranches});
+		}
+		if (definition.Op == TerrainOp::Noise) {
+			const TerrainNoise& noise = definition.Noise;
+			plan.Noise = noise;
+			plan.Sampler.SetSeed(noise.Seed);
+			plan.Sampler.SetNoiseType(noise.Type);
+			plan.Sampler.SetFrequency(noise.Frequency);
+			plan.Sampler.SetInterp(noise.Interp);
+			plan.Sampler.SetFractalOctaves(noise.Octaves);
+			plan.Sampler.SetFractalLacunarity(noise.Lacunarity);
+			plan.Sampler.SetFractalGain(noise.Gain);
+			plan.Sampler.SetFractalType(noise.Fractal);
+		}
+
+		// (inputs are released after the output is assigned, so that a step never writes over its own inputs)
+		if (!shareBuffers) {
+			continue;
+		}
+		for (int input : inputs[node]) {
+			if ((lastUse[input] == step) && (std::find(freeBuffers.begin(), freeBuffers.end(), buffer[input]) == freeBuffers.end())) {
+				freeBuffers.push_back(buffer[input]);
+			}
+		}
+		for (const auto& [selector, branch, numBranches] : guards[node]) {
+			if ((lastUse[selector] == step) && (std::find(freeBuffers.begin(), freeBuffers.end(), buffer[selector]) == freeBuffers.end())) {
+				freeBuffers.push_back(buffer[selector]);
+			}
+		}
+	}
+
+	for (const auto& [name, node] : graph.Outputs) {
+		m_Outputs.push_back(buffer[merged[node]]);
+		m_OutputSteps.push_back(stepOf[merged[node]]);
+	}
+	return true;
+}
+
+
+void TerrainPlan::Evaluate(const int left, const int bottom, const int width, const int height, ChunkLayers& buffers, const std::vector<bool>* stepsToRun, const int stride) const {
+	HZ_PROFILE_FUNCTION();
+
+	const size_t size = static_cast<size_t>(width) * height;
+	buffers.resize(m_NumBuffers * size);
+
+	for (size_t stepIndex = 0; stepIndex < m_Steps.size(); ++stepIndex) {
+		if (stepsToRun && !(*stepsToRun)[stepIndex]) {
+			continue;
+		}
+		const Step& step = m_Steps[stepIndex];
+		float* output = buffers.data() + (step.Output * size);
+		const float* input = step.Inputs.empty() ? nullptr : buffers.data() + (step.Inputs[0] * size);
+
+		auto isNeeded = [&](const size_t index) {
+			if (step.Guard.empty()) {
+				return true;
+			}
+			for (const GuardTerm& term : step.Guard) {
+				if (SelectBranch(buffers[(term.Selector * size) + index], term.NumBranches) == term.Branch) {
+					return true;
+				}
+			}
+			return false;
+		};
+
+		switch (step.Op) {
+			case TerrainOp::Noise:
+				for (int y = 0; y < height; ++y) {
+					for (int x = 0; x < width; ++x) {
+						const size_t index = (static_cast<size_t>(y) * width) + x;
+						output[index] = isNeeded(index) ? step.Sampler.GetNoise(static_cast<float>(left + (x * stride)), static_cast<float>(bottom + (y * stride))) : 0.0f;
+					}
+				}
+				break;
+
+			case TerrainOp::Constant:
+				std::fill(output, output + size, step.Values[0]);
+				break;
+
+			case TerrainOp::Remap:
+				std::copy(input, input + size, output);
+				break;
+
+			case TerrainOp::Threshold:
+				for (size_t index = 0; index < size; ++index) {
+					const float value = input[index];
+					const auto passed = step.Strict ?
+						std::lower_bound(step.Values.begin(), step.Values.end(), value) :
+						std::upper_bound(step.Values.begin(), step.Values.end(), value);
+					output[index] = static_cast<float>(passed - step.Values.begin());
+				}
+				break;
+
+			case TerrainOp::Select: {
+				const int numBranches = static_cast<int>(step.Inputs.size()) - 1;
+				for (size_t index = 0; index < size; ++index) {
+					const int branch = SelectBranch(input[index], numBranches);
+					output[index] = buffers[(step.Inputs[branch + 1] * size) + index];
+				}
+				break;
+			}
+
+			case TerrainOp::Tile:
+				std::fill(output, output + width, 0.0f);
+				for (int y = 1; y < height; ++y) {
+					const size_t row = static_cast<size_t>(y) * width;
+					output[row] = 0.0f;
+					for (int x = 1; x < width; ++x) {
+						const size_t index = row + x;
+						output[index] = (27.0f * input[index - 1]) + (9.0f * input[index]) + (3.0f * input[index - width - 1]) + input[index - width];
+					}
+				}
+				break;
+		}
+
+		if ((step.Scale != 1.0f) || (step.Offset != 0.0f)) {
+			for (size_t index = 0; index < size; ++index) {
+				output[index] = (output[index] * step.Scale) + step.Offset;
+			}
+		}
+	}
+}
+
+
+const float* TerrainPlan::GetOutput(const ChunkLayers& buffers, const int output) const {
+	const size_t size = m_NumBuffers ? buffers.size() / m_NumBuffers : 0;
+	return buffers.data() + (m_Outputs[output] * size);
+}
+
+
+bool TerrainPlan::GetChangedSteps(const TerrainPlan& previous, std::vector<bool>& changed) const {
+	if ((m_Steps.size() != previous.m_Steps.size()) || (m_NumBuffers != previous.m_NumBuffers) || (m_Outputs != previous.m_Outputs)) {
+		return false;
+	}
+
+	// Steps are in dependency order, so one pass propagates changes.  (bufferChanged tracks the step that last wrote each buffer)
+	changed.assign(m_Steps.size(), false);
+	std::vector<bool> bufferChanged(m_NumBuffers, false);
+	for (size_t index = 0; index < m_Steps.size(); ++index) {
+		const Step& step = m_Steps[index];
+		const Step& before = previous.m_Steps[index];
+		if ((step.Op != before.Op) || (step.Output != before.Output) || (step.Inputs != before.Inputs) || (step.Guard.size() != before.Guard.size())) {
+			return false;
+		}
+
+		bool stepChanged = (step.Values != before.Values) || (step.Strict != before.Strict) || (step.Scale != before.Scale) || (step.Offset != before.Offset) ||
+			((step.Op == TerrainOp::Noise) && (step.Noise != before.Noise));
+		for (uint32_t input : step.Inputs) {
+			stepChanged = stepChanged || bufferChanged[input];
+		}
+		for (size_t term = 0; term < step.Guard.size(); ++term) {
+			const GuardTerm& guard = step.Guard[term];
+			const GuardTerm& guardBefore = before.Guard[term];
+			if ((guard.Selector != guardBefore.Selector) || (guard.Branch != guardBefore.Branch) || (guard.NumBranches != guardBefore.NumBranches)) {
+				return false;
+			}
+			stepChanged = stepChanged || bufferChanged[guard.Selector];
+		}
+		changed[index] = stepChanged;
+		bufferChanged[step.Output] = stepChanged;
+	}
+	return true;
+}
+
+
+size_t TerrainPlan::GetOutputStep(const int output) const {
+	return m_OutputSteps[output];
+}
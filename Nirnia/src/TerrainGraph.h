@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Chunk.h"
+#include "Tree.h"
+
+#include "FastNoise.h"
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Terrain definition: a graph of nodes, each of which computes one value per tile, loaded from a data file.
+//
+// Every line of the file is a node, an output, or a tree scatter rule.  Nodes may only refer to nodes defined
+// above them.  '#' starts a comment.
+//
+//   noise <name> [seed=<int>] [type=<Simplex|SimplexFractal|Perlin|...>] [frequency=<f>] [interp=<Linear|Hermite|Quintic>]
+//                [octaves=<int>] [lacunarity=<f>] [gain=<f>] [fractal=<FBM|Billow|RigidMulti>]
+//       FastNoise sampled at the tile's position (unspecified settings take FastNoise's defaults)
+//   constant <name> <value>
+//   remap <name> <input> <scale> <offset>
+//       input * scale + offset
+//   threshold <name> <input> <'>'|'>='> <t0> [<t1> ...]
+//       number of (ascending) thresholds that the input is above, e.g. "threshold x v >= 0 1" is 0 for v < 0,
+//       1 for 0 <= v < 1, and 2 for v >= 1
+//   select <name> <selector> <input0> [<input1> ...]
+//       input<selector>.  Inputs are only evaluated for the tiles that select them.
+//   tile <name> <input>
+//       combines the input at the tile's four corners (input is sampled at the top right corner of each tile):
+//       27 * top left + 9 * top right + 3 * bottom left + bottom right.  0 along the bottom row and left column.
+//   output <ground|trees> <node>
+//       ground is the tile's ground type (index into the ground textures)
+//       trees selects which scatter rule (if any) applies to the tile
+//   scatter <trees value> <kind> <probability> <offset min> <offset max> <scale min> <scale max> [<cluster kind> <cluster probability>]
+//       tiles whose trees value (rounded to the nearest integer) is <trees value> grow a tree of the given kind with the given probability, positioned and
+//       scaled randomly (but reproducibly) within the tile.  A cluster rule grows a second tree in front of the
+//       first.  <trees value> is an integer in [0, TreeScatterRule::MaxValue].
+struct TerrainNoise {
+	int Seed = 1337;
+	FastNoise::NoiseType Type = FastNoise::Simplex;
+	float Frequency = 0.01f;
+	FastNoise::Interp Interp = FastNoise::Quintic;
+	int Octaves = 3;
+	float Lacunarity = 2.0f;
+	float Gain = 0.5f;
+	FastNoise::FractalType Fractal = FastNoise::FBM;
+
+	bool operator==(const TerrainNoise& other) const;
+	bool operator!=(const TerrainNoise& other) const { return !(*this == other); }
+};
+
+
+enum class TerrainOp : uint8_t {
+	Noise,
+	Constant,
+	Remap,
+	Threshold,
+	Select,
+	Tile
+};
+
+
+struct TerrainNode {
+	std::string Name;
+	TerrainOp Op;
+	std::vector<int> Inputs;     // indices of earlier nodes
+	std::vector<float> Values;   // Constant: {value}.  Remap: {scale, offset}.  Threshold: thresholds, ascending
+	bool Strict = false;         // Threshold: true => input must be > threshold (rather than >=) to count
+	TerrainNoise Noise;
+};
+
+
+struct TreeScatterRule {
+	static constexpr int MaxValue = 255;
+
+	int Value;                   // trees output (rounded) that the rule applies to
+	TreeKind Kind;
+	float Probability;
+	float OffsetMin;
+	float OffsetMax;
+	float ScaleMin;              // scale is not randomized if min == max
+	float ScaleMax;
+	TreeKind ClusterKind = TreeKind::ClusteredShrub;
+	float ClusterProbability = 0.0f;
+
+	bool operator==(const TreeScatterRule& other) const;
+	bool operator!=(const TreeScatterRule& other) const { return !(*this == other); }
+};
+
+
+struct TerrainGraph {
+	std::vector<TerrainNode> Nodes;
+	std::vector<std::pair<std::string, int>> Outputs;  // output name, node
+	std::vector<TreeScatterRule> TreeRules;
+
+	// Returns index of the named node (or output), or -1
+	int FindNode(const std::string& name) const;
+	int FindOutput(const std::string& name) const;
+
+	// On failure, error describes the problem (and the graph is left in an unspecified state)
+	bool Load(const std::string& path, std::string& error);
+	bool Parse(std::istream& stream, std::string& error);
+
+	// Writes the graph in the format Parse() reads (comments in the original file are not kept)
+	bool Save(const std::string& path, std::string& error) const;
+	void Write(std::ostream& stream) const;
+};
+
+
+// A terrain graph compiled into a flat list of steps, each of which is evaluated over a whole region of tiles at a
+// time.
+//
+// Compilation merges identical nodes (so that, e.g., a noise layer used by several others is only sampled once),
+// drops nodes that do not contribute to an output, folds remaps into the step that produces their input, and works
+// out which tiles each step is actually needed for (from the selects that consume it).  Intermediate results share
+// buffers once they are no longer needed.
+//
+// Evaluate() is const, and can be called from any number of threads at once (each with its own buffers).
+//
+// A plan compiled without shared buffers keeps every intermediate result, so a region can later be brought up to date
+// with a new version of the graph by re-evaluating only the steps that the change affects (see GetChangedSteps()).
+class TerrainPlan
+{
+public:
+	// On failure, error describes the problem and the plan is left empty.
+	// If shareBuffers is false, every step has a buffer of its own.
+	bool Compile(const TerrainGraph& graph, std::string& error, const bool shareBuffers = true);
+
+	// Evaluates every output for tiles [left, left + width) x [bottom, bottom + height).
+	// buffers is scratch space, and holds the results (get them with GetOutput()).  (It is a chunk's Layers, so that a
+	// chunk can keep them without a copy.)
+	// If stepsToRun is given, only those steps are evaluated.  buffers must then already hold the results of evaluating
+	// the same region with a plan of the same structure, compiled without shared buffers.
+	// If stride is more than 1, only every stride'th tile is evaluated: result (x, y) is for tile
+	// (left + x * stride, bottom + y * stride).  (a tile op then combines neighbouring samples, rather than the tile's
+	// own corners)
+	void Evaluate(const int left, const int bottom, const int width, const int height, ChunkLayers& buffers, const std::vector<bool>* stepsToRun = nullptr, const int stride = 1) const;
+
+	// Returns the results of the output with the given index (in TerrainGraph::Outputs), row major
+	const float* GetOutput(const ChunkLayers& buffers, const int output) const;
+
+	// Compares this plan with one compiled from an earlier version of the graph.  If both have the same structure (the
+	// same steps, wired to the same buffers), sets changed to the steps whose results can differ between them (because
+	// their own settings differ, or those of a step they depend on do) and returns true.  Otherwise returns false.
+	bool GetChangedSteps(const TerrainPlan& previous, std::vector<bool>& changed) const;
+
+	// Index of the step that computes the output with the given index
+	size_t GetOutputStep(const int output) const;
+
+	size_t GetStepCount() const { return m_Steps.size(); }
+	uint32_t GetBufferCount() const { return m_NumBuffers; }
+
+private:
+	// Tiles for which selector buffer picks the given branch (of a select with the given number of branches)
+	struct GuardTerm {
+		uint32_t Selector;
+		int Branch;
+		int NumBranches;
+	};
+
+	struct Step {
+		TerrainOp Op;
+		uint32_t Output;                                // buffer index
+		std::vector<uint32_t> Inputs;                   // buffer indices
+		std::vector<float> Values;
+		bool Strict = false;
+		TerrainNoise Noise;
+		FastNoise Sampler;                              // (set up from Noise)
+		float Scale = 1.0f;                             // applied to the step's result
+		float Offset = 0.0f;
+		std::vector<GuardTerm> Guard;                   // if not empty, the step is only evaluated for tiles matching one of these (and is 0 elsewhere)
+	};
+
+	std::vector<Step> m_Steps;
+	std::vector<uint32_t> m_Outputs;                    // buffer index of each output
+	std::vector<size_t> m_OutputSteps;                  // step index of each output
+	uint32_t m_NumBuffers = 0;                          // (buffers are laid out end to end in the scratch space)
+};
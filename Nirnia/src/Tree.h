@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Things that grow on the map (trees and shrubs).
+// The kind determines which sprite is drawn, and how the sprite and its shadow are positioned relative to the
+// point where the tree meets the ground.
+enum class TreeKind : uint8_t {
+	LargeTree,
+	SmallTree,
+	LoneShrub,
+	Shrub,
+	ClusteredShrub,  // smaller shrub, growing in front of a Shrub
+
+	NumKinds
+};
+
+
+// Per-kind constants used to reconstruct tree (and tree shadow) geometry at draw time.
+// Sizes and offsets are multiplied by the tree's scale.
+struct TreeKindInfo {
+	uint8_t Texture;        // index into the tree textures
+	float Width;            // sprite size
+	float Height;
+	float OffsetY;          // sprite centre, relative to the tree's anchor point
+	float ShadowSize;       // shadow is square
+	float ShadowOffsetY;    // shadow centre, relative to the tree's anchor point
+	bool Blocking;          // true => the tile the tree stands on cannot be walked through
+};
+
+
+inline const TreeKindInfo& GetTreeKindInfo(const TreeKind kind) {
+	static constexpr TreeKindInfo kinds[static_cast<int>(TreeKind::NumKinds)] = {
+		//Texture Width  Height OffsetY ShadowSize ShadowOffsetY Blocking
+		{ 0,      1.0f,  2.0f,  1.0f,   1.2f,       0.36f,       true  },  // LargeTree      (large light green tree)
+		{ 1,      1.0f,  2.0f,  1.0f,   1.0f,       0.3f,        true  },  // SmallTree      (small light green tree)
+		{ 9,      1.0f,  1.0f,  0.0f,   1.0f,       0.0f,        false },  // LoneShrub      (small orange shrub)
+		{ 8,      1.0f,  1.0f,  0.0f,   1.0f,      -0.1f,        false },  // Shrub          (large orange shrub)
+		{ 9,      1.0f,  1.0f,  0.0f,   0.7f,      -0.21f,       false },  // ClusteredShrub (small orange shrub)
+	};
+	return kinds[static_cast<int>(kind)];
+}
+
+
+// A tree, packed into 6 bytes.
+// X and Y are the tree's anchor point (where it meets the ground) relative to the bottom left of its chunk, in
+// 8.8 fixed point.  Everything else required to draw the tree (sprite, size, shadow, and depth) is derived from
+// the kind and scale at draw time.
+struct Tree {
+	uint16_t X;
+	uint16_t Y;
+	uint8_t Scale;          // 2.6 fixed point
+	TreeKind Kind;
+
+	static constexpr float PositionOne = 256.0f;
+	static constexpr float ScaleOne = 64.0f;
+
+	float GetX() const { return X / PositionOne; }
+	float GetY() const { return Y / PositionOne; }
+	float GetScale() const { return Scale / ScaleOne; }
+};
+static_assert(sizeof(Tree) == 6, "Tree is expected to pack into 6 bytes");
+
+
+// x and y are relative to the bottom left of the chunk, and must be in the range [0, 256)
+// scale must be in the range [0, 4)
+inline Tree PackTree(const TreeKind kind, const float x, const float y, const float scale) {
+	return {
+		static_cast<uint16_t>(std::lround(x * Tree::PositionOne)),
+		static_cast<uint16_t>(std::lround(y * Tree::PositionOne)),
+		static_cast<uint8_t>(std::lround(scale * Tree::ScaleOne)),
+		kind
+	};
+}
@@ -0,0 +1,241 @@
+#include "WorldGenerator.h"
+
+#include "Navigation.h"
+#include "Random.h"
+
+#include <Hazel/Core/Layer.h>
+
+#include <algorithm>
+
+bool WorldGenerator::Load(const std::string& path, std::string& error) {
+	TerrainGraph terrain;
+	return terrain.Load(path, error) && SetTerrain(terrain, error);
+}
+
+
+bool WorldGenerator::SetTerrain(const TerrainGraph& terrain, std::string& error) {
+	HZ_PROFILE_FUNCTION();
+
+	int groundOutput = terrain.FindOutput("ground");
+	if (groundOutput < 0) {
+		error = "terrain has no ground output";
+		return false;
+	}
+	int treesOutput = terrain.FindOutput("trees");
+	TerrainPlan plan;
+	if (!plan.Compile(terrain, error, !m_KeepLayers)) {
+		return false;
+	}
+
+	// Work out which steps the change affects.  If the plan has changed shape, then everything has.
+	const uint64_t version = m_Version + 1;
+	std::vector<bool> changed;
+	if ((m_Version > 0) && (groundOutput == m_GroundOutput) && (treesOutput == m_TreesOutput) && plan.GetChangedSteps(m_Plan, changed)) {
+		for (size_t step = 0; step < changed.size(); ++step) {
+			if (changed[step]) {
+				m_StepVersions[step] = version;
+			}
+		}
+	} else {
+		m_StepVersions.assign(plan.GetStepCount(), version);
+		m_StructureVersion = version;
+	}
+	if ((m_Version == 0) || (terrain.TreeRules != m_Terrain.TreeRules)) {
+		m_TreeRulesVersion = version;
+	}
+	m_Version = version;
+
+	m_Terrain = terrain;
+	m_TreeRuleIndex.clear();
+	for (size_t index = 0; index < m_Terrain.TreeRules.size(); ++index) {
+		const int value = m_Terrain.TreeRules[index].Value;
+		if (value >= static_cast<int>(m_TreeRuleIndex.size())) {
+			m_TreeRuleIndex.resize(value + 1, -1);
+		}
+		if (m_TreeRuleIndex[value] < 0) {
+			m_TreeRuleIndex[value] = static_cast<int16_t>(index);  // (the first rule for a value applies)
+		}
+	}
+	m_Plan = std::move(plan);
+	m_GroundOutput = groundOutput;
+	m_TreesOutput = treesOutput;
+	return true;
+}
+
+
+void WorldGenerator::SetKeepLayers(const bool keepLayers) {
+	HZ_PROFILE_FUNCTION();
+
+	if (keepLayers == m_KeepLayers) {
+		return;
+	}
+	m_KeepLayers = keepLayers;
+	if (m_Version == 0) {
+		return;
+	}
+	// Sharing buffers or not only changes where steps keep their results, not the steps themselves, so the step
+	// versions still apply.  (the terrain compiled before, so it compiles again)
+	std::string error;
+	TerrainPlan plan;
+	plan.Compile(m_Terrain, error, !m_KeepLayers);
+	m_Plan = std::move(plan);
+}
+
+
+size_t WorldGenerator::GetStaleStepCount(const uint64_t version) const {
+	size_t count = 0;
+	for (size_t step = 0; step < m_StepVersions.size(); ++step) {
+		count += IsStepStale(step, version) ? 1 : 0;
+	}
+	return count;
+}
+
+
+bool WorldGenerator::IsGroundStale(const uint64_t version) const {
+	return (m_GroundOutput >= 0) && IsStepStale(m_Plan.GetOutputStep(m_GroundOutput), version);
+}
+
+
+bool WorldGenerator::AreTreesStale(const uint64_t version) const {
+	return (m_TreeRulesVersion > version) || ((m_TreesOutput >= 0) && IsStepStale(m_Plan.GetOutputStep(m_TreesOutput), version));
+}
+
+
+void WorldGenerator::Generate(const int left, const int bottom, const int width, const int height, Chunk& chunk, const Chunk* previous) const {
+	HZ_PROFILE_FUNCTION();
+
+	const int right = left + width;
+	const int top = bottom + height;
+	const size_t size = static_cast<size_t>(width) * height;
+
+	ChunkGround& groundType = chunk.GroundType;
+	ChunkTrees& trees = chunk.Trees;
+	chunk.Layers.clear();
+	chunk.LayersVersion = 0;
+	if (m_GroundOutput < 0) {
+		groundType.assign(size, 0);
+		trees.clear();
+		return;
+	}
+
+	// previous can only be built on if its layers come from a plan of the same shape
+	const bool incremental = previous && m_KeepLayers && (previous->LayersVersion >= m_StructureVersion) &&
+		(previous->Layers.size() == m_Plan.GetBufferCount() * size);
+
+	// Layers that are kept are evaluated in place
+	ChunkLayers scratch;
+	ChunkLayers& buffers = m_KeepLayers ? chunk.Layers : scratch;
+	std::vector<bool> stepsToRun;
+	if (incremental) {
+		buffers = previous->Layers;
+		stepsToRun.resize(m_Plan.GetStepCount());
+		for (size_t step = 0; step < stepsToRun.size(); ++step) {
+			stepsToRun[step] = IsStepStale(step, previous->LayersVersion);
+		}
+	}
+	m_Plan.Evaluate(left, bottom, width, height, buffers, incremental ? &stepsToRun : nullptr);
+	if (m_KeepLayers) {
+		chunk.LayersVersion = m_Version;
+	}
+
+	if (incremental && !IsGroundStale(previous->LayersVersion)) {
+		groundType = previous->GroundType;
+	} else {
+		const float* ground = m_Plan.GetOutput(buffers, m_GroundOutput);
+		groundType.assign(size, 0);
+		for (int y = bottom + 1; y < top; ++y) {
+			for (int x = left + 1; x < right; ++x) {
+				uint32_t index = ((y - bottom) * width) + (x - left);
+				groundType[index] = static_cast<uint8_t>(std::clamp(ground[index], 0.0f, static_cast<float>(MaxGroundType)));
+			}
+		}
+	}
+
+	if (incremental && !AreTreesStale(previous->LayersVersion)) {
+		trees = previous->Trees;
+		return;
+	}
+	trees.clear();
+	const float* treeValues = (m_TreesOutput >= 0) ? m_Plan.GetOutput(buffers, m_TreesOutput) : nullptr;
+	if (!treeValues) {
+		return;
+	}
+	trees.reserve(width * height);
+
+	// Trees
+	// The result is underwhelming.  Some sort of poisson disk sampling, with noise-dependent radius might be better
+	// (with pre-generated level of fixed size)
+	for (int y = bottom + 1; y < top; ++y) {
+		for (int x = left + 1; x < right; ++x) {
+			uint32_t index = ((y - bottom) * width) + (x - left);
+			const TreeScatterRule* rule = FindTreeRule(treeValues[index]);
+			if (!rule) {
+				continue;
+			}
+
+			// nb: the order in which random numbers are drawn is part of the world's definition
+			Random treeRandomizer({x, y});
+			if (treeRandomizer.Uniform0_1() < rule->Probability) {
+				auto plant = [&](const TreeKind kind) {
+					float xOffset = treeRandomizer.Uniform(rule->OffsetMin, rule->OffsetMax);
+					float yOffset = treeRandomizer.Uniform(rule->OffsetMin, rule->OffsetMax);
+					float scale = (rule->ScaleMin < rule->ScaleMax) ? treeRandomizer.Uniform(rule->ScaleMin, rule->ScaleMax) : rule->ScaleMin;
+					trees.push_back(PackTree(kind, x - xOffset - left, y - yOffset - bottom, scale));
+				};
+				plant(rule->Kind);
+				if ((rule->ClusterProbability > 0.0f) && (treeRandomizer.Uniform0_1() < rule->ClusterProbability)) {
+					plant(rule->ClusterKind);
+				}
+			}
+		}
+	}
+
+	trees.shrink_to_fit();
+}
+
+
+void WorldGenerator::Sample(const int left, const int bottom, const int width, const int height, const int stride, std::vector<uint8_t>& groundTypes, std::vector<float>& treeDensity) const {
+	HZ_PROFILE_FUNCTION();
+
+	const size_t size = static_cast<size_t>(width) * height;
+	groundTypes.assign(size, 0);
+	treeDensity.assign(size, 0.0f);
+	if (m_GroundOutput < 0) {
+		return;
+	}
+
+	// An extra row and column of samples below and to the left, to be the corners of the first row and column
+	const int paddedWidth = width + 1;
+	ChunkLayers buffers;
+	m_Plan.Evaluate(left - stride, bottom - stride, paddedWidth, height + 1, buffers, nullptr, stride);
+	const float* ground = m_Plan.GetOutput(buffers, m_GroundOutput);
+	const float* treeValues = (m_TreesOutput >= 0) ? m_Plan.GetOutput(buffers, m_TreesOutput) : nullptr;
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const size_t padded = (static_cast<size_t>(y + 1) * paddedWidth) + x + 1;
+			const size_t index = (static_cast<size_t>(y) * width) + x;
+			groundTypes[index] = static_cast<uint8_t>(std::clamp(ground[padded], 0.0f, static_cast<float>(MaxGroundType)));
+			if (treeValues) {
+				if (const TreeScatterRule* rule = FindTreeRule(treeValues[padded])) {
+					treeDensity[index] = rule->Probability * (1.0f + rule->ClusterProbability);
+				}
+			}
+		}
+	}
+}
+
+
+bool WorldGenerator::IsWalkable(const int x, const int y) const {
+	HZ_PROFILE_FUNCTION();
+
+	// (the tile's corners are the row and column below and to the left of it)
+	Chunk chunk;
+	Generate(x - 1, y - 1, 2, 2, chunk);
+	if (!IsWalkableGround(chunk.GroundType[3])) {
+		return false;
+	}
+	return std::none_of(chunk.Trees.begin(), chunk.Trees.end(), [x, y](const Tree& tree) {
+		return GetTreeKindInfo(tree.Kind).Blocking && (GetTile({x - 1 + tree.GetX(), y - 1 + tree.GetY()}) == glm::ivec2{x, y});
+	});
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Chunk.h"
+#include "TerrainGraph.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Generates map content (ground tiles and trees) from a terrain definition (see TerrainGraph.h).
+//
+// The content of any tile depends only on the terrain definition and the tile's position, so regions can be
+// generated in any order, and on any number of threads at once (Generate() is const).
+//
+// Every change of terrain bumps the generator's version.  A generator that keeps layers stores every intermediate
+// result of the terrain plan in the chunks it generates, and remembers the version at which each step of the plan
+// last changed, so that a chunk generated with an earlier version can be brought up to date by re-evaluating only
+// the steps that have changed since.  (e.g. a change to the tree noise leaves the ground layers alone, and a change to
+// the grass noise only re-samples it for the tiles that are grass)
+class WorldGenerator
+{
+public:
+	static constexpr const char* DefaultTerrainPath = "assets/terrain/default.terrain";
+	static constexpr uint8_t MaxGroundType = 82;
+
+public:
+	explicit WorldGenerator(const bool keepLayers = false) : m_KeepLayers(keepLayers) {}
+
+	// Layers cost several floats per tile, so are best kept only while the terrain is being changed.  Switching does
+	// not change the version: layers kept before switching off are still good when switching back on.
+	void SetKeepLayers(const bool keepLayers);
+	bool IsKeepingLayers() const { return m_KeepLayers; }
+
+	// Loads and compiles a terrain definition.  On failure, error says why and the generator is left unchanged.
+	// (until a terrain has been loaded, everything generated is water)
+	bool Load(const std::string& path, std::string& error);
+	bool SetTerrain(const TerrainGraph& terrain, std::string& error);
+
+	const TerrainGraph& GetTerrain() const { return m_Terrain; }
+
+	uint64_t GetVersion() const { return m_Version; }
+
+	// What bringing a chunk generated at the given version up to date involves
+	size_t GetStepCount() const { return m_Plan.GetStepCount(); }
+	size_t GetStaleStepCount(const uint64_t version) const;
+	bool IsGroundStale(const uint64_t version) const;
+	bool AreTreesStale(const uint64_t version) const;
+
+	// Generates tiles [left, left + width) x [bottom, bottom + height) into chunk.
+	// Ground types are row major, width x height.  The bottom row and left column are left as 0 (each tile needs the
+	// terrain at its corners, and those tiles' corners lie outside the region).
+	// Trees are positioned relative to (left, bottom).
+	// If previous is given, it must be the same region, generated by an earlier version of this generator.  Whatever
+	// has not changed since is taken from it rather than generated again.
+	void Generate(const int left, const int bottom, const int width, const int height, Chunk& chunk, const Chunk* previous = nullptr) const;
+
+	// Samples every stride'th tile, for a coarse overview of a wide area (e.g. the minimap).  Sample (x, y) is tile
+	// (left + x * stride, bottom + y * stride).  groundTypes gets each sample's ground type, and treeDensity the number
+	// of trees expected per tile there (going by the scatter rules, no trees are placed).  Only one tile in
+	// stride x stride is evaluated, so this is far cheaper than generating the region.
+	// nb: a sample's ground type is made from the terrain at the neighbouring samples, so of its four corners only the
+	// top right one (the terrain at the sampled tile itself) is reliable.
+	void Sample(const int left, const int bottom, const int width, const int height, const int stride, std::vector<uint8_t>& groundTypes, std::vector<float>& treeDensity) const;
+
+	// Returns true if tile (x, y) can be walked on, worked out from the terrain alone (by generating just that tile),
+	// so the answer never depends on which chunks happen to have been generated yet
+	bool IsWalkable(const int x, const int y) const;
+
+private:
+	bool IsStepStale(const size_t step, const uint64_t version) const { return m_StepVersions[step] > version; }
+
+	// Scatter rule for a tile with the given trees value, or nullptr
+	const TreeScatterRule* FindTreeRule(const float treeValue) const {
+		const long value = std::lround(treeValue);
+		return ((value >= 0) && (value < static_cast<long>(m_TreeRuleIndex.size())) && (m_TreeRuleIndex[value] >= 0)) ? &m_Terrain.TreeRules[m_TreeRuleIndex[value]] : nullptr;
+	}
+
+private:
+	bool m_KeepLayers;
+	TerrainGraph m_Terrain;
+	TerrainPlan m_Plan;
+	int m_GroundOutput = -1;
+	int m_TreesOutput = -1;                  // (optional)
+	std::vector<int16_t> m_TreeRuleIndex;    // by rule value: index into m_Terrain.TreeRules, or -1 if no rule has that value
+
+	uint64_t m_Version = 0;                  // 0 => no terrain yet
+	uint64_t m_StructureVersion = 0;         // version at which the plan's structure last changed.  (layers from earlier versions can't be built on)
+	uint64_t m_TreeRulesVersion = 0;         // version at which the scatter rules last changed
+	std::vector<uint64_t> m_StepVersions;    // version at which each step's results last changed
+};